@@ -0,0 +1,96 @@
+// buffer::find microbenchmark
+// g++ -O2 -std=c++11 buffer_find_bench.cpp -lmoonnet -o buffer_find_bench
+
+#include <moonnet/moonnet.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace moon;
+
+static volatile size_t sink = 0;
+
+template <typename F>
+double run(const char* name, size_t bytes, int rounds, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) sink += f();
+    auto end = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration<double>(end - start).count();
+    double gbps = bytes * (double)rounds / sec / 1e9;
+    std::cout << name << ": " << gbps << " GB/s" << std::endl;
+    return gbps;
+}
+
+int main() {
+    const size_t size = 64 * 1024;
+    const int rounds = 20000;
+    // 分隔符位于末尾，模拟整块扫描
+    std::string data(size, 'a');
+    data[size - 2] = '\r';
+    data[size - 1] = '\n';
+    const std::string pat = "--boundary";
+    std::string pdata(size, 'b');
+    memcpy(&pdata[size - pat.size()], pat.data(), pat.size());
+
+    buffer buf;
+    buf.append(data.data(), data.size());
+    buffer pbuf;
+    pbuf.append(pdata.data(), pdata.size());
+
+    std::cout << "-- single byte --" << std::endl;
+    run("memchr", size, rounds, [&] {
+        return (size_t)((const char*)memchr(data.data(), '\n', size) -
+                        data.data());
+    });
+    // 交替查找两个目标，避免命中已扫描位置
+    int turn = 0;
+    run("buffer::find(char)", size, rounds, [&] {
+        return buf.find(++turn & 1 ? '\n' : '\r');
+    });
+
+    std::cout << "-- crlf --" << std::endl;
+    run("std::search", size, rounds, [&] {
+        static const char crlf[] = "\r\n";
+        return (size_t)(std::search(data.begin(), data.end(), crlf,
+                                    crlf + 2) -
+                        data.begin());
+    });
+    run("buffer::find_crlf", size, rounds, [&] {
+        return ++turn & 1 ? buf.find_crlf() : buf.find("a\r\n", 3);
+    });
+
+    std::cout << "-- multi-byte pattern --" << std::endl;
+    run("std::search", size, rounds, [&] {
+        return (size_t)(std::search(pdata.begin(), pdata.end(), pat.begin(),
+                                    pat.end()) -
+                        pdata.begin());
+    });
+    run("buffer::find(pattern)", size, rounds, [&] {
+        return ++turn & 1 ? pbuf.find(pat.data(), pat.size())
+                          : pbuf.find(pat.data() + 1, pat.size() - 1);
+    });
+
+    // 数据分片到达：每次追加1KB后查找，对比每次从头扫描
+    std::cout << "-- incremental, 1KB reads --" << std::endl;
+    const size_t chunk = 1024;
+    run("memchr rescan", size, rounds / 20, [&] {
+        size_t r = 0;
+        for (size_t n = chunk; n <= size; n += chunk) {
+            const void* p = memchr(data.data(), '\n', n);
+            r = p ? (const char*)p - data.data() : 0;
+        }
+        return r;
+    });
+    run("buffer::find resume", size, rounds / 20, [&] {
+        buffer b;
+        size_t r = 0;
+        for (size_t n = 0; n < size; n += chunk) {
+            b.append(data.data() + n, chunk);
+            r = b.find('\n');
+        }
+        return r;
+    });
+    return 0;
+}
@@ -6,8 +6,7 @@ using namespace moon;
 
 
 void handle_read(bfevent* bev){
-    std::string str = bev->receive();
-    bev->sendout(str);
+    bev->transfer_to(bev);
 }
 
 
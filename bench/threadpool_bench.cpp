@@ -0,0 +1,74 @@
+// threadpool吞吐测试：固定线程数下每秒完成的任务数，以及突发负载下的弹性扩容
+// g++ -O2 -std=c++11 threadpool_bench.cpp -lmoonnet -lpthread -o threadpool_bench
+
+#include <moonnet/moonnet.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace moon;
+
+static std::atomic<uint64_t> sink{0};
+
+// 约work_ns纳秒的纯计算任务
+static void spin(int work_ns) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(work_ns);
+    uint64_t x = 0;
+    while (std::chrono::steady_clock::now() < end) ++x;
+    sink += x;
+}
+
+static double run(int workers, int tasks, int work_ns) {
+    threadpool pool(workers, workers);
+    std::atomic<int> done{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < tasks; ++i) {
+        pool.add_task([&done, work_ns] {
+            spin(work_ns);
+            ++done;
+        });
+    }
+    while (done.load() < tasks) std::this_thread::yield();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                               start)
+                     .count();
+    return tasks / sec;
+}
+
+int main() {
+    const int tasks = 200000;
+    unsigned cores = std::thread::hardware_concurrency();
+    std::cout << "cores: " << cores << std::endl;
+    for (int work_ns : {0, 2000, 20000}) {
+        std::cout << "-- task ~" << work_ns << "ns --" << std::endl;
+        int n = work_ns >= 20000 ? tasks / 10 : tasks;
+        for (int w = 1; w <= (int)cores * 2 && w <= 32; w *= 2) {
+            std::cout << w << " workers: " << (uint64_t)run(w, n, work_ns)
+                      << " tasks/s" << std::endl;
+        }
+    }
+
+    // 弹性：1个最小线程，突发阻塞型任务时按排队时间扩容，空闲后回落
+    std::cout << "-- elastic (min 1, max 16, 5ms blocking tasks) --" << std::endl;
+    threadpool pool(1, 16);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> done{0};
+    for (int i = 0; i < 400; ++i) {
+        pool.add_task([&done] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ++done;
+        });
+    }
+    int peak = 0;
+    while (done.load() < 400) {
+        peak = std::max(peak, pool.getthreads());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                               start)
+                     .count();
+    std::cout << "400 tasks in " << sec * 1000 << " ms, peak threads " << peak
+              << ", avg wait " << pool.getwait_us() << " us" << std::endl;
+    return 0;
+}
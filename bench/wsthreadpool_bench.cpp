@@ -0,0 +1,101 @@
+// 三种线程池在任务耗时不均时的对比：threadpool / lfthreadpool / wsthreadpool
+// g++ -O2 -std=c++11 wsthreadpool_bench.cpp -lmoonnet -lpthread -o wsthreadpool_bench
+
+#include <moonnet/moonnet.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace moon;
+
+static std::atomic<uint64_t> sink{0};
+
+// 约work_ns纳秒的纯计算任务
+static void spin(int work_ns) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(work_ns);
+    uint64_t x = 0;
+    while (std::chrono::steady_clock::now() < end) ++x;
+    sink += x;
+}
+
+// 重尾分布：大部分任务5us，1%的任务500us，模拟压缩/加密等大小差异很大的卸载任务
+static std::vector<int> make_costs(int tasks) {
+    std::mt19937 rng(42);
+    std::vector<int> costs(tasks);
+    for (int i = 0; i < tasks; ++i)
+        costs[i] = rng() % 100 == 0 ? 500000 : 5000;
+    return costs;
+}
+
+template <typename Pool>
+static double run(Pool& pool, const std::vector<int>& costs) {
+    std::atomic<int> done{0};
+    int tasks = (int)costs.size();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < tasks; ++i) {
+        int c = costs[i];
+        while (!pool.add_task([&done, c] {
+            spin(c);
+            ++done;
+        }))
+            std::this_thread::yield();
+    }
+    while (done.load() < tasks) std::this_thread::yield();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// 分治型负载：任务内部再提交子任务，wsthreadpool压入本线程队列(LIFO)
+static void split(wsthreadpool* pool, std::atomic<int>* done, int depth) {
+    if (depth == 0) {
+        spin(2000);
+        ++*done;
+        return;
+    }
+    pool->add_task(split, pool, done, depth - 1);
+    pool->add_task(split, pool, done, depth - 1);
+}
+
+int main() {
+    const int tasks = 40000;
+    int cores = (int)std::thread::hardware_concurrency();
+    std::cout << "cores: " << cores << std::endl;
+    std::vector<int> costs = make_costs(tasks);
+
+    std::cout << "-- " << tasks << " tasks, 99% 5us / 1% 500us --" << std::endl;
+    {
+        threadpool pool(cores, cores);
+        std::cout << "threadpool:   " << run(pool, costs) * 1000 << " ms"
+                  << std::endl;
+    }
+    {
+        lfthreadpool pool(cores, 4096);
+        std::cout << "lfthreadpool: " << run(pool, costs) * 1000 << " ms"
+                  << std::endl;
+        pool.t_shutdown();
+    }
+    {
+        wsthreadpool pool(cores);
+        std::cout << "wsthreadpool: " << run(pool, costs) * 1000 << " ms"
+                  << ", steals " << pool.getsteals() << ", parks "
+                  << pool.getparks() << std::endl;
+    }
+
+    std::cout << "-- fork/join, depth 14 (16384 leaves of 2us) --" << std::endl;
+    {
+        wsthreadpool pool(cores);
+        std::atomic<int> done{0};
+        auto start = std::chrono::steady_clock::now();
+        pool.add_task(split, &pool, &done, 14);
+        while (done.load() < (1 << 14)) std::this_thread::yield();
+        double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        std::cout << "wsthreadpool: " << sec * 1000 << " ms, steals "
+                  << pool.getsteals() << std::endl;
+    }
+    return 0;
+}
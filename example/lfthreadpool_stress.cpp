@@ -0,0 +1,63 @@
+#include <moonnet/moonnet.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// 从所有loop线程同时向lfthreadpool提交任务，检查每个被接受的任务都恰好执行一次
+int main() {
+    const int loops = 4;
+    const int rounds = 200;  // 每个loop的提交轮数
+    const int burst = 500;   // 每轮提交的任务数
+
+    moon::eventloop base;
+    moon::looptpool lpool(&base);
+    lpool.create_pool_noadjust(loops, -1);
+    moon::lfthreadpool pool(4, 1024);
+
+    std::atomic<uint64_t> accepted{0}, rejected{0}, executed{0};
+    std::atomic<uint64_t> sum_in{0}, sum_out{0};
+    std::atomic<int> finished{0};
+
+    std::vector<moon::timerevent*> timers;
+    std::vector<int> round(loops, 0);
+    for (moon::eventloop* loop : lpool.getloops()) {
+        moon::timerevent* tev = new moon::timerevent(loop, 1, true);
+        int* r = &round[timers.size()];
+        tev->setcb([&, tev, r] {
+            if (*r == rounds) return;
+            for (int i = 0; i < burst; ++i) {
+                uint64_t v = (uint64_t)*r * burst + i + 1;
+                if (pool.add_task([&executed, &sum_out, v] {
+                        sum_out += v;
+                        ++executed;
+                    })) {
+                    ++accepted;
+                    sum_in += v;
+                } else {
+                    ++rejected;  // 队列满时的拒绝策略
+                }
+            }
+            if (++*r == rounds) {
+                tev->del_listen();
+                ++finished;
+            }
+        });
+        tev->enable_listen();
+        timers.push_back(tev);
+    }
+
+    while (finished.load() < loops)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    pool.t_shutdown();  // 执行完队列中的任务后退出
+
+    std::cout << "accepted " << accepted << ", rejected " << rejected
+              << ", executed " << executed << std::endl;
+    bool ok = accepted == executed && sum_in == sum_out;
+    std::cout << (ok ? "OK" : "MISMATCH") << std::endl;
+
+    lpool.stop();
+    for (auto tev : timers) delete tev;
+    return ok ? 0 : 1;
+}
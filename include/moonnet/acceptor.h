@@ -34,6 +34,8 @@ Author: MoonforDream
 #ifndef _ACCEPTOR_H_
 #define _ACCEPTOR_H_
 
+#include "sockopts.h"
+#include <cstddef>
 #include <functional>
 
 namespace moon {
@@ -45,18 +47,29 @@ namespace moon {
     class acceptor {
     public:
         using Callback = std::function<void(int)>;
+        using ACallback = std::function<bool()>;  // 返回false表示拒绝新连接
         acceptor(int port, eventloop *base);
         ~acceptor();
         void listen();                          // 开始监听
         void stop();                            // 停止监听
-        void init_sock(int port);               // 建立监听套接字
+        // 建立监听套接字，opts同时应用于之后接受的连接
+        void init_sock(int port, const sockopts &opts = sockopts());
         void setcb(const Callback &accept_cb);  // 设置回调函数
+        // 准入控制：admit返回false时，reject为true则接受后立即RST关闭，
+        // 否则停止监听，由调用者稍后重新listen()
+        void setadmit(const ACallback &admit, bool reject);
+        size_t getrejected() const;  // 被拒绝的连接数
+        bool listening() const;
         void handle_accept();  // acceptor事件回调函数，用来接收连接
     private:
         int lfd_;
         eventloop *loop_;
         event *ev_;
         Callback cb_;  // 连接后回调函数
+        sockopts opts_;
+        ACallback admit_;
+        bool reject_ = true;
+        size_t rejected_ = 0;
         bool shutdown_;
     };
 
@@ -47,6 +47,8 @@ namespace moon {
         virtual void enable_listen() = 0;
         virtual void del_listen() = 0;
         virtual void update_ep() = 0;
+        // 由eventloop在迭代结束时调用，发送合并后的待发送数据
+        virtual void handle_flush() {}
     };
 
 }  // namespace moon
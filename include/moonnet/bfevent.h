@@ -37,17 +37,33 @@ Author: MoonforDream
 #include "base_event.h"
 #include "buffer.h"
 #include "event.h"
+#include <deque>
 #include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 namespace moon {
     class event;
     class eventloop;
 
+    // 连接统计，系统调用次数包含返回EAGAIN的调用
+    struct connstats {
+        uint64_t rxbytes = 0;
+        uint64_t txbytes = 0;
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t cpu_ns = 0;  // 处理本连接事件(含用户回调)的累计耗时
+    };
+
     class bfevent : public base_event {
     public:
         using RCallback = std::function<void(bfevent *)>;
         using Callback = std::function<void()>;
+        using WCallback = std::function<void(bfevent *, size_t)>;
         bfevent(eventloop *base, int fd, uint32_t events);
         ~bfevent();
         int getfd() const;
@@ -69,9 +85,49 @@ namespace moon {
 
         void sendout(const char *data, size_t len);
         void sendout(const std::string &data);
+        // 聚合发送多段数据，空闲时直接writev，未写完部分才复制进outbuff_
+        void sendout(const struct iovec *iov, int iovcnt);
+        // 零拷贝发送文件[offset,offset+len)区间，autoclose为true时发送完毕后关闭fd
+        void send_file(int fd, off_t offset, size_t len,
+                       bool autoclose = false);
+        // 开启MSG_ZEROCOPY发送，threshold为使用零拷贝的最小长度，0为关闭
+        bool set_zerocopy(size_t threshold);
+        // 发送期间data须保持有效，内核完成通知到达后调用release释放；
+        // 若关闭时仍未完成，连接以RST中止后再释放
+        void sendout_zc(const char *data, size_t len, const Callback &release);
+        // 输出高低水位：待发送数据超过high触发hcb，随后降至low以下触发lcb
+        void set_watermark(size_t high, size_t low, const WCallback &hcb,
+                           const WCallback &lcb);
+        // 超过高水位时暂停target读事件，降至低水位时恢复，可为自身
+        void set_pausetarget(bfevent *target);
+        size_t pending_bytes() const;  // 获取待发送数据大小
+        // 开启后sendout只追加数据，由eventloop在本轮迭代结束时统一发送
+        void set_cork(bool on);
+        void flush();  // 立即发送合并的数据
+        // 输入限制：inbuff_超过high时停止读取，消费至low以下时恢复，high为0时关闭
+        void set_inlimit(size_t high, size_t low);
+        // 直接通过getinbuff()消费数据后调用，检查是否恢复读取
+        void update_inlimit();
+        // 批量读：先读至EAGAIN或读满budget字节再调用一次readcb，EOF/错误在数据之后通知
+        void set_batchread(bool on, size_t budget = 1024 * 1024);
         size_t receive(char *data, size_t len);
         std::string receive(size_t len);
         std::string receive();
+        // 不复制地访问输入数据：peek()开始的readbytes()字节连续可读
+        const char *peek() const;
+        size_t readbytes() const;
+        void retrieve(size_t len);  // 消费len字节
+        // 将输入数据全部移入peer的发送队列，peer发送队列为空时直接交换缓冲区
+        // peer可为自身，须与本事件在同一eventloop
+        size_t transfer_to(bfevent *peer);
+        // 将本连接后续输入转发给peer(同一loop)，优先经管道splice零拷贝，
+        // 不支持时退回transfer_to；peer写满时暂停读取。peer为nullptr时停止转发
+        // 返回是否使用splice
+        bool forward_to(bfevent *peer);
+        // 开启连接统计：收发字节、读写次数与回调耗时(rdtsc)，
+        // 所在loop开启enable_topk时同时计入耗时排行
+        void set_accounting(bool on);
+        connstats getstats() const;  // 未开启时全为0，须在loop线程调用
         void enable_events(uint32_t op);   // 添加监听事件类型
         void disable_events(uint32_t op);  // 取消监听事件类型
         void enable_read();
@@ -88,17 +144,37 @@ namespace moon {
         // 关闭事件
         void close_event() {
             if (closed_) return;
+            stop_forward();
+            if (fwdsrc_) fwdsrc_->forward_to(nullptr);
             del_listen();
+            abort_zc();
             ::close(fd_);
+            clear_segs();
+            if (abovehigh_ && pausetarget_ && pausetarget_ != this)
+                pausetarget_->resume_read(PAUSE_PEER);
+            abovehigh_ = false;
             closed_ = true;
         }
 
         void handle_read() {
+            if (fwdpeer_) {
+                handle_forward();
+                return;
+            }
+            if (batchread_) {
+                handle_read_batch();
+                return;
+            }
             while (true) {
                 int errnum = 0;
                 int n = inbuff_.readiov(fd_, errnum);
+                count_in(n);
                 if (n > 0) {
                     if (readcb_) readcb_(this);
+                    if (inhigh_ > 0 && inbuff_.readbytes() >= inhigh_) {
+                        pause_read(PAUSE_INPUT);
+                        break;
+                    }
                 } else if (n == 0) {
                     if (eventcb_) eventcb_();
                     break;
@@ -114,30 +190,60 @@ namespace moon {
             }
         }
 
-        void handle_write() {
-            while (outbuff_.readbytes() > 0) {
-                const char *data = outbuff_.peek();
-                size_t len = outbuff_.readbytes();
-                ssize_t n = write(fd_, data, len);
-                if (n > 0) {
-                    outbuff_.retrieve(n);
-                    if (writecb_) writecb_();
-                } else if (n == -1) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        break;
-                    } else {
-                        perror("write error");
-                        if (eventcb_) eventcb_();
-                        break;
-                    }
-                }
-            }
-            if (outbuff_.readbytes() == 0) ev_->disable_write();
-        }
+        void handle_read_batch();
+        void handle_forward();
+        bool drain_pipe();      // 将管道中的数据splice到fwdpeer_
+        void resume_forward();  // fwdpeer_可写后恢复转发
+        void stop_forward();
+
+        void handle_write();
 
-        void handle_event() {
-            if (eventcb_) eventcb_();
+        void handle_event();
+
+        void count_in(ssize_t n) {
+            if (!acct_) return;
+            ++acct_->st.reads;
+            if (n > 0) acct_->st.rxbytes += n;
+        }
+        void count_out(ssize_t n) {
+            if (!acct_) return;
+            ++acct_->st.writes;
+            if (n > 0) acct_->st.txbytes += n;
         }
+        // 计时执行事件处理函数并计入统计
+        void run_timed(void (bfevent::*fn)());
+
+        // 输出路径上的文件段/零拷贝用户内存段
+        struct outseg {
+            int fd;  // 文件描述符，用户内存段为-1
+            off_t offset;
+            size_t len;
+            uint64_t mark;  // 该段之前需先发送的outbuff_字节累计位置
+            bool autoclose;
+            const char *data;  // 用户内存段数据
+            Callback release;  // 用户内存段释放回调
+            bool copy;          // 源不支持sendfile，改用pread+write
+            std::string stage;  // copy模式下已读出但尚未写入socket的数据
+        };
+
+        void drain_out(size_t len);  // 丢弃outbuff_已发送数据并推进outpos_
+        int send_seg(outseg &seg);   // 发送数据段，-1出错/0阻塞/1有进展
+        int send_zc(outseg &seg);
+        void read_errqueue();  // 读取零拷贝完成通知
+        void release_zc();     // 释放内核已不再引用的用户内存
+        void abort_zc();       // 关闭前仍有未完成的零拷贝发送时以RST中止连接
+        bool has_pending() const;    // 是否还有未发送数据
+        void clear_segs();
+        void check_highwater();
+        void check_lowwater();
+        void queue_flush();
+        void start_write();
+        void handle_flush() override;
+
+        // 暂停读事件的原因，全部解除后才恢复监听
+        enum : uint8_t { PAUSE_PEER = 1, PAUSE_INPUT = 2, PAUSE_FORWARD = 4 };
+        void pause_read(uint8_t why);
+        void resume_read(uint8_t why);
 
     private:
         eventloop *loop_;
@@ -145,6 +251,39 @@ namespace moon {
         event *ev_;
         buffer inbuff_;
         buffer outbuff_;
+        std::deque<outseg> segs_;
+        uint64_t outpos_ = 0;  // 已从outbuff_发送的累计字节数
+        size_t zcthreshold_ = 0;
+        bool zccopied_ = false;  // 内核回退为复制时不再使用零拷贝
+        uint32_t zcseq_ = 0;     // 下一次零拷贝发送的通知序号
+        uint32_t zcdone_ = 0;    // 该序号之前的发送均已完成
+        std::vector<std::pair<uint32_t, uint32_t>> zcranges_;  // 乱序完成区间
+        std::deque<std::pair<uint32_t, Callback>> zcwait_;  // 等待完成的释放回调
+        size_t highwater_ = 0;  // 0表示不限制
+        size_t lowwater_ = 0;
+        bool abovehigh_ = false;
+        bfevent *pausetarget_ = nullptr;
+        uint8_t readpause_ = 0;
+        size_t inhigh_ = 0;  // 0表示不限制
+        size_t inlow_ = 0;
+        WCallback highcb_;
+        WCallback lowcb_;
+        bool batchread_ = false;
+        size_t readbudget_ = 0;  // 批量读单次最多读取的字节数
+        bfevent *fwdpeer_ = nullptr;  // 转发目标
+        bfevent *fwdsrc_ = nullptr;   // 转发到本连接的源
+        int pipefd_[2] = {-1, -1};
+        size_t pipebytes_ = 0;  // 管道中尚未写出的字节数
+        bool splice_ = false;
+        bool corked_ = false;
+        bool flushq_ = false;  // 是否已在eventloop刷新队列中
+        // 统计数据，计时期间本事件可能被析构，故共享持有
+        struct acct {
+            connstats st;
+            uint64_t cycles = 0;
+            bool dead = false;
+        };
+        std::shared_ptr<acct> acct_;
         RCallback readcb_;
         Callback writecb_;
         Callback eventcb_;
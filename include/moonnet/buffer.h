@@ -24,6 +24,10 @@ namespace moon {
         ~buffer() { reset(); }
         // 向writer_后添加数据
         void append(const char* data, size_t len);
+        // 向reader_前添加数据，头部空间不足时移动可读数据
+        void prepend(const char* data, size_t len);
+        void headroom(size_t len);        // 为空缓冲区预留头部空间
+        size_t prependable() const;       // 获取头部可用空间大小
         // 读取reader_和writer_之间的len长度可读数据
         size_t remove(char* data, size_t len);
         std::string remove(size_t len);
@@ -34,16 +38,28 @@ namespace moon {
         size_t writebytes() const;  // 获取可写数据大小
         const char* peek() const;   // 获取缓冲区内容
         void reset();               // 重置缓冲区
+        void swap(buffer& other);   // 交换两个缓冲区内容，不复制数据
         ssize_t readiov(int fd, int& errnum);
 
+        static const size_t npos = static_cast<size_t>(-1);
+        // 在可读数据中查找，返回相对peek()的偏移，未找到返回npos
+        // 未找到时记住已扫描位置，数据追加后再次查找同一目标不会重复扫描
+        size_t find(char c);
+        size_t find_crlf();
+        size_t find(const char* pat, size_t len);
+
     private:
         // 确保有足够的科可写空间
         void able_wirte(size_t len);
+        // 读指针前移len后同步已扫描位置
+        void advance(size_t len);
 
     private:
         std::vector<char> buffer_;
         uint64_t reader_;
         uint64_t writer_;
+        size_t scanned_ = 0;   // 相对reader_已确认不含scankey_的字节数
+        std::string scankey_;  // 上次未找到的查找目标
     };
 
 }  // namespace moon
@@ -0,0 +1,129 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _CODEC_H_
+#define _CODEC_H_
+
+#include "bfevent.h"
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace moon {
+
+    class buffer;
+
+    // 消息帧编解码器基类，切分bfevent输入缓冲区中的完整帧
+    class codec {
+    public:
+        // 帧回调，data指向inbuff_内的载荷，仅在回调期间有效
+        using FCallback = std::function<void(bfevent*, const char*, size_t)>;
+        codec(const FCallback& fcb);
+        virtual ~codec() {}
+        void setfcb(const FCallback& fcb);
+        // 返回读回调，可直接传给server::set_tcpcb或bfevent::setrcb
+        bfevent::RCallback reader();
+        void attach(bfevent* bev);       // 将bev的读回调设置为本编解码器
+        void handle_read(bfevent* bev);  // 逐帧回调inbuff_中所有完整帧
+        // 编码buf中的载荷为一帧(就地添加帧头帧尾)，失败(如超出长度限制)返回false
+        bool encode(buffer* buf) const;
+        // 将载荷编码为一帧发送，帧头、载荷、帧尾一次writev发出，失败返回false
+        bool send(bfevent* bev, const char* data, size_t len);
+
+    protected:
+        // 解析起始处的一帧，返回帧总长度，0为数据不完整，-1为非法帧
+        // off/len返回载荷在可读数据中的偏移与长度
+        virtual ssize_t decode(buffer* buf, size_t& off, size_t& len) = 0;
+        virtual size_t headlen() const { return 0; }  // 编码所需头部空间
+        // 为长度len的载荷生成帧头(写入head，至多headlen()字节，长度存入hlen)
+        // 与帧尾(tail，指向codec内部数据)，不合法返回false
+        virtual bool frame(size_t len, char* head, size_t& hlen,
+                           iovec& tail) const = 0;
+
+    private:
+        FCallback fcb_;
+    };
+
+    // 长度前缀帧：width为1/2/4/8字节定长或VARINT
+    class lencodec : public codec {
+    public:
+        static const int VARINT = 0;
+        lencodec(const FCallback& fcb, int width = 4, bool bigendian = true,
+                 size_t maxlen = 64 * 1024 * 1024);
+
+    protected:
+        ssize_t decode(buffer* buf, size_t& off, size_t& len) override;
+        size_t headlen() const override { return width_ ? width_ : 10; }
+        bool frame(size_t len, char* head, size_t& hlen,
+                   iovec& tail) const override;
+
+    private:
+        int width_;
+        bool bigendian_;
+        size_t maxlen_;
+    };
+
+    // 分隔符帧，载荷不含分隔符
+    class delimcodec : public codec {
+    public:
+        delimcodec(const FCallback& fcb, const std::string& delim = "\r\n",
+                   size_t maxlen = 64 * 1024);
+
+    protected:
+        ssize_t decode(buffer* buf, size_t& off, size_t& len) override;
+        bool frame(size_t len, char* head, size_t& hlen,
+                   iovec& tail) const override;
+
+    private:
+        std::string delim_;
+        size_t maxlen_;
+    };
+
+    // 定长帧
+    class fixcodec : public codec {
+    public:
+        fixcodec(const FCallback& fcb, size_t size);
+
+    protected:
+        ssize_t decode(buffer* buf, size_t& off, size_t& len) override;
+        bool frame(size_t len, char* head, size_t& hlen,
+                   iovec& tail) const override;
+
+    private:
+        size_t size_;
+    };
+
+}  // namespace moon
+
+#endif
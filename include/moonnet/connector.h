@@ -0,0 +1,94 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _CONNECTOR_H_
+#define _CONNECTOR_H_
+
+#include <functional>
+#include <arpa/inet.h>
+
+namespace moon {
+
+    class event;
+    class eventloop;
+    class bfevent;
+    class timerevent;
+
+    // 非阻塞TCP连接器，连接成功后在loop上生成bfevent
+    class connector {
+    public:
+        using CCallback = std::function<void(bfevent*)>;  // 连接成功
+        using FCallback = std::function<void(int)>;  // 重试耗尽，参数为errno
+        connector(eventloop* loop, const sockaddr_in& addr);
+        ~connector();
+        void setcb(const CCallback& ccb, const FCallback& fcb);
+        void set_timeout(int timeout_ms);  // 单次连接超时，0为不限
+        // 失败后最多重试maxretry次，间隔从init_ms开始翻倍，不超过max_ms
+        void set_retry(int maxretry, int init_ms, int max_ms);
+        void start();  // 开始连接，需在loop线程调用
+        void stop();   // 取消连接或重试
+        bool connecting() const;
+        eventloop* getloop() const;
+        const sockaddr_in& getaddr() const;
+        connector(const connector&) = delete;
+        connector& operator=(const connector&) = delete;
+
+    private:
+        void connect_once();
+        void handle_connect();  // 连接完成(EPOLLOUT/EPOLLERR)
+        void handle_timeout();
+        void retry(int err);
+        void close_sock();
+
+    private:
+        // 空闲、等待连接完成、等待重试
+        enum state { IDLE, CONNECTING, BACKOFF };
+        eventloop* loop_;
+        sockaddr_in addr_;
+        int fd_ = -1;
+        event* ev_ = nullptr;
+        timerevent* timer_ = nullptr;
+        state state_ = IDLE;
+        int timeout_ms_ = 3000;
+        int maxretry_ = 3;
+        int init_ms_ = 100;
+        int max_ms_ = 5000;
+        int attempt_ = 0;
+        int backoff_ms_ = 0;
+        CCallback connectcb_;
+        FCallback failcb_;
+    };
+
+}  // namespace moon
+
+#endif
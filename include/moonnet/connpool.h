@@ -0,0 +1,87 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _CONNPOOL_H_
+#define _CONNPOOL_H_
+
+#include <functional>
+#include <list>
+#include <vector>
+#include <arpa/inet.h>
+
+namespace moon {
+
+    class eventloop;
+    class bfevent;
+    class connector;
+
+    // 单个loop内到同一上游地址的长连接池，仅在所属loop线程使用，无需加锁
+    class connpool {
+    public:
+        using CCallback = std::function<void(bfevent*)>;  // 失败时参数为nullptr
+        connpool(eventloop* loop, const sockaddr_in& addr, size_t maxidle = 16);
+        ~connpool();
+        // 优先复用空闲连接，否则新建连接，结果通过cb返回
+        void get(const CCallback& cb);
+        // 归还仍可用的连接，空闲连接数超过maxidle时关闭
+        void put(bfevent* bev);
+        void set_timeout(int timeout_ms);
+        void set_retry(int maxretry, int init_ms, int max_ms);
+        size_t idle() const;     // 空闲连接数
+        size_t pending() const;  // 正在建立的连接数
+        eventloop* getloop() const;
+        connpool(const connpool&) = delete;
+        connpool& operator=(const connpool&) = delete;
+
+    private:
+        void discard(bfevent* bev);  // 关闭并释放空闲连接
+        void handle_connect(connector* conn, const CCallback& cb,
+                            bfevent* bev);
+
+    private:
+        eventloop* loop_;
+        sockaddr_in addr_;
+        size_t maxidle_;
+        int timeout_ms_ = 3000;
+        int maxretry_ = 0;
+        int init_ms_ = 100;
+        int max_ms_ = 5000;
+        std::list<bfevent*> idle_;
+        std::vector<connector*> free_;  // 可复用的连接器
+        std::vector<connector*> all_;
+        size_t pending_ = 0;
+    };
+
+}  // namespace moon
+
+#endif
@@ -70,6 +70,7 @@ namespace moon {
         Callback getwcb();
         Callback getecb();
         void setrevents(const uint32_t revents);  // 设置触发事件类型
+        uint32_t getrevents() const;              // 获取触发事件类型
         void enable_events(uint32_t op);          // 添加监听事件类型
         void disable_events(uint32_t op);         // 取消监听事件类型
         void update_ep() override;                // 更新监听事件
@@ -35,6 +35,7 @@ Author: MoonforDream
 #define _EVENTLOOP_H_
 
 #include "wrap.h"
+#include "topk.h"
 #include <atomic>
 #include <cstdlib>
 #include <iostream>
@@ -43,6 +44,7 @@ Author: MoonforDream
 #include <list>
 #include <unistd.h>
 #include <strings.h>
+#include <pthread.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/timerfd.h>
@@ -54,6 +56,7 @@ namespace moon {
     class base_event;
     class event;
     class loopthread;
+    class watchdog;
 
     // reactor类-->事件循环类
     class eventloop {
@@ -80,10 +83,33 @@ namespace moon {
         void write_eventfd();
 
         void add_pending_del(base_event* ev);
+        // 负载统计：开启后记录每轮处理耗时，可在其他线程读取
+        void enable_stats(bool on);
+        // 延迟估计(微秒)：以每轮处理耗时的滑动平均近似事件从就绪到被处理的等待
+        uint64_t getlag_us() const;
+        int getready() const;  // 最近一轮epoll_wait返回的就绪事件数，近似队列深度
+        // 本轮迭代结束时调用ev->handle_flush()，用于合并写
+        void add_pending_flush(base_event* ev);
+        void del_pending_flush(base_event* ev);
+        // 看门狗：被监视时记录每个回调的序号、开始时间和fd
+        void setwatchdog(watchdog* dog);
+        // 心跳快照，返回当前回调已执行的微秒数，空闲时为0
+        uint64_t getheartbeat(uint64_t& seq, int& fd, event*& ev) const;
+        pthread_t getthread() const;  // 运行loop()的线程，未运行时为0
+        // 连接耗时排行：开启了统计的bfevent将回调耗时计入k个槽位的topk
+        void enable_topk(size_t k);  // 只生效一次
+        topk* gettopk() const;
+        // 耗时最高的n个连接，cost/error换算为纳秒，total_ns为所有连接的总耗时
+        std::vector<talker> gettop(size_t n, uint64_t* total_ns = nullptr) const;
+        void reset_topk();  // 开始新的统计窗口
+        void setcpu(int cpu);  // 记录loop线程绑定的cpu，由loopthread调用
+        int getcpu() const;    // 未绑定时为-1
 
     private:
         // 更新负载
         void updateload(int n) { load_ += n; }
+        void do_flush();
+        void beat(int fd, event* ev);
 
     private:
         int epfd_;
@@ -94,6 +120,21 @@ namespace moon {
         std::list<event*> evlist_;
         std::vector<epoll_event> events_;
         std::vector<base_event*> delque_;
+        std::vector<base_event*> flushque_;
+        std::vector<base_event*> flushing_;
+        std::atomic<bool> stats_{false};  // 可由其他线程开关
+        std::atomic<uint64_t> lag_us_{0};      // 每轮处理耗时的滑动平均
+        std::atomic<uint64_t> busysince_{0};   // 本轮开始处理的时间，空闲时为0
+        std::atomic<uint64_t> lastend_{0};     // 上一轮处理结束的时间
+        std::atomic<int> ready_{0};
+        std::atomic<watchdog*> dog_{nullptr};
+        std::atomic<uint64_t> seq_{0};        // 回调序号
+        std::atomic<uint64_t> cbstart_{0};    // 当前回调开始时间，空闲时为0
+        std::atomic<int> cbfd_{-1};
+        std::atomic<event*> cbev_{nullptr};
+        std::atomic<pthread_t> tid_{0};  // 由loop线程发布，看门狗线程读取
+        std::atomic<topk*> topk_{nullptr};
+        std::atomic<int> cpu_{-1};
         loopthread* baseloop_;
     };
 }  // namespace moon
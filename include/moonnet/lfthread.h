@@ -34,11 +34,13 @@ Author: MoonforDream
 #ifndef _LFTHREAD_H_
 #define _LFTHREAD_H_
 
+#include <atomic>
 #include <functional>
 #include <thread>
 #include <list>
 #include <vector>
 #include "ringbuff.h"
+#include "mpmcring.h"
 
 namespace moon {
 
@@ -68,8 +70,8 @@ namespace moon {
         void t_task();
 
     private:
-        ringbuff<task> buffer_;  // 任务队列(无锁环形缓冲区)
-        bool shutdown_;  // 无任何其他线程操作，所以不需要原子变量
+        mpmcring<task> buffer_;  // 任务队列(多生产者无锁环形队列)
+        std::atomic<bool> shutdown_;
         std::thread t_;
     };
 
@@ -70,6 +70,8 @@ namespace moon {
         lfthreadpool& operator=(const lfthreadpool&) = delete;
 
     private:
+        bool enter();
+        void leave();
         const size_t getnext();
         void adjust_task();
         void del_thread_dispath();
@@ -90,7 +92,8 @@ namespace moon {
         std::atomic<bool> shutdown_;
         PoolMode mode_;
         size_t buffsize_;
-        size_t next_ = 0;
+        std::atomic<size_t> next_;   // 静态模式下的轮询票号
+        std::atomic<int> inflight_;  // 正在提交中的add_task数量
         int timesec_ = 5;
         int coolsec_ = 30;
         int load_max = 80;
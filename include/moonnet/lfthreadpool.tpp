@@ -42,7 +42,8 @@ namespace moon {
     /**
      * @brief Adds a new task to the thread pool.
      *        The task is assigned to a thread based on the current pool mode
-     * and load balancing.
+     * and load balancing. Safe to call from any number of threads at once,
+     * e.g. from every eventloop thread.
      *
      * @tparam _Fn Function type of the task.
      * @tparam _Args Variadic template for function arguments.
@@ -54,12 +55,13 @@ namespace moon {
      */
     template <typename _Fn, typename... _Args>
     bool lfthreadpool::add_task(_Fn&& fn, _Args&&... args) {
-        if (shutdown_.load(std::memory_order_acquire)) return false;
+        if (!enter()) return false;
         auto f = std::bind(std::forward<_Fn>(fn), std::forward<_Args>(args)...);
         size_t idx = getnext();
-        if (idx >= workers_.size()) return false;  // 防止越界
-        //        return workers_[idx]->enqueue_task(std::move(f));
-        return workers_[idx]->enqueue_task(f);
+        bool ok = idx < workers_.size() &&  // 防止越界
+                  workers_[idx]->enqueue_task_move(std::move(f));
+        leave();
+        return ok;
     }
 
     /**
@@ -77,11 +79,13 @@ namespace moon {
      */
     template <typename _Fn, typename... _Args>
     bool lfthreadpool::add_task_move(_Fn&& fn, _Args&&... args) {
-        if (shutdown_.load(std::memory_order_acquire)) return false;
+        if (!enter()) return false;
         auto f = std::bind(std::forward<_Fn>(fn), std::forward<_Args>(args)...);
         size_t idx = getnext();
-        if (idx >= workers_.size()) return false;  // 防止越界
-        return workers_[idx]->enqueue_task_move(std::move(f));
+        bool ok = idx < workers_.size() &&  // 防止越界
+                  workers_[idx]->enqueue_task_move(std::move(f));
+        leave();
+        return ok;
     }
 }  // namespace moon
 
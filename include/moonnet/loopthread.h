@@ -29,6 +29,7 @@ namespace moon {
         ~loopthread();
         void _init_();         // 初始化
         eventloop* getloop();  // 获取loop_
+        bool setaffinity(int cpu);  // 将loop线程绑定到cpu
         void join() {
             if (t_.joinable()) t_.join();
         }
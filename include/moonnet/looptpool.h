@@ -54,10 +54,15 @@ namespace moon {
         void create_pool_noadjust(
             int n, int timeout);  // 不进行调度管理的指定线程初始化线程池
         eventloop* ev_dispatch();  // 分发事件
+        // 优先分发给绑定在cpu上的从reactor，没有时按默认策略
+        eventloop* ev_dispatch(int cpu);
+        // 将从reactor依次绑定到cpus，为空时使用进程可用的cpu，返回绑定的cpu列表
+        std::vector<int> pin_loops(const std::vector<int>& cpus = {});
         void delloop_dispatch();   // 删除从reactor并分发事件
         void addloop();            // 添加eventloop(从reactor)
         void adjust_task();    // 管理线程任务，调度管理从reactor
         int getscale();        // 获取平均负载
+        std::vector<eventloop*> getloops() const;  // 获取所有从reactor
         void enable_adjust();  // 启用动态均衡调度任务
         looptpool(const looptpool&) = delete;
         looptpool& operator=(const looptpool&) = delete;
@@ -4,20 +4,28 @@
 #include "base_event.h"
 #include "event.h"
 #include "eventloop.h"
+#include "topk.h"
 #include "buffer.h"
 #include "bfevent.h"
+#include "codec.h"
 #include "udpevent.h"
 #include "signalevent.h"
 #include "timerevent.h"
 #include "loopthread.h"
 #include "looptpool.h"
 #include "threadpool.h"
+#include "sockopts.h"
 #include "acceptor.h"
+#include "connector.h"
+#include "connpool.h"
+#include "watchdog.h"
 #include "server.h"
 #include "wrap.h"
 #include "ringbuff.h"
+#include "mpmcring.h"
 #include "lfthread.h"
 #include "lfthreadpool.h"
+#include "wsthreadpool.h"
 
 
 #endif  // !_MOONNET_H_
@@ -0,0 +1,91 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _MPMCRING_H_
+#define _MPMCRING_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace moon {
+
+    // 多生产者多消费者有界无锁队列(Vyukov)
+    // 每个槽位带序号，生产者/消费者各自CAS推进下标，槽位序号表示可写/可读
+    // 与ringbuff(单生产者单消费者)不同，可以从任意多个线程同时push/pop
+    template <class T>
+    class mpmcring {
+    public:
+        mpmcring(size_t size = 1024);
+        ~mpmcring();
+        /** push function **/
+        bool push(const T& item);
+        bool push_move(T&& item);
+        /** pop function **/
+        bool pop(T& item);
+        bool pop_move(T& item);
+
+        size_t capacity() const;
+        size_t size() const;  // 并发下为近似值
+        bool empty() const;
+        bool full() const;
+        void swap(mpmcring& other) noexcept;  // 非线程安全，仅在无并发访问时使用
+
+        mpmcring(const mpmcring&) = delete;
+        mpmcring& operator=(const mpmcring&) = delete;
+
+    private:
+        struct cell {
+            std::atomic<size_t> seq;
+            T data;
+        };
+        template <class U>
+        bool enqueue(U&& item);
+        static size_t adj_size(size_t size);
+
+    private:
+        size_t mask_;
+        cell* buffer_;
+        char pad0_[64];  // 避免伪共享
+        std::atomic<size_t> enq_;
+        char pad1_[64];
+        std::atomic<size_t> deq_;
+        char pad2_[64];
+    };
+
+}  // namespace moon
+
+#include "mpmcring.tpp"
+
+#endif  // !_MPMCRING_H_
@@ -39,8 +39,10 @@ Author: MoonforDream
 #include "looptpool.h"
 #include "eventloop.h"
 #include "bfevent.h"
+#include "watchdog.h"
 #include <functional>
 #include <mutex>
+#include <vector>
 
 namespace moon {
 
@@ -62,9 +64,26 @@ namespace moon {
         void init_pool(int tnum, int timeout);  // 以指定线程初始化线程池
         void init_pool_noadjust(
             int tnum, int timeout);  // 不进行调度管理的指定线程初始化线程池
-        void enable_tcp(int port);  // 启用tcp服务
+        void enable_tcp(int port,
+                        const sockopts& opts = sockopts());  // 启用tcp服务
         void enable_tcp_accept();   // 开启tcp连接监听器
         void disable_tcp_accept();  // 取消tcp连接监听
+        // 过载保护：从reactor延迟超过high_us时拒绝(RST)或暂停接受新连接，
+        // 降至low_us以下恢复；maxready>0时就绪事件数超过它也视为过载
+        void set_overload(int high_us, int low_us, bool reject = true,
+                          int maxready = 0);
+        bool overloaded();          // 检查并更新过载状态
+        size_t getrejected() const; // 被拒绝的连接数
+        // 看门狗：主/从reactor的回调执行超过threshold_ms时记录fd与调用栈，
+        // 需在init_pool之后调用，动态扩容新增的从reactor不在监视范围内
+        void enable_watchdog(int threshold_ms,
+                             const watchdog::WCallback& cb = nullptr);
+        // 连接统计：之后接受的连接开启set_accounting，各从reactor开启k槽位耗时排行
+        void enable_accounting(size_t k = 16);
+        // 按cpu分发：从reactor绑定到cpus(为空时用进程可用cpu)，新连接交给
+        // SO_INCOMING_CPU对应的从reactor，udp分片挂载CBPF按接收cpu选择；
+        // 需在init_pool_noadjust之后、add_udpev_shards之前调用
+        void set_cpu_dispatch(const std::vector<int>& cpus = {});
         eventloop* getloop();
         // 分发事件,建议先初始化线程池
         eventloop* dispatch();
@@ -79,6 +98,10 @@ namespace moon {
         // udpevent推荐使用以下这个函数添加，出错会自动清理
         udpevent* add_udpev(int port, const UCallback& rcb,
                             const Callback& ecb);
+        // 每个从reactor各创建一个SO_REUSEPORT绑定同一端口的udpevent，
+        // 由内核按流哈希分摊，建议配合init_pool_noadjust使用
+        std::vector<udpevent*> add_udpev_shards(int port, const UCallback& rcb,
+                                                const Callback& ecb);
         signalevent* add_sev(int signo, const SCallback& cb);
         signalevent* add_sev(const std::vector<int>& signals,
                              const SCallback& cb);
@@ -101,13 +124,24 @@ namespace moon {
         void del_timeev(timerevent *tev); */
     private:
         void acceptcb_(int fd) {
-            bfevent* bev =
-                new bfevent(pool_.ev_dispatch(), fd, EPOLLIN | EPOLLET);
+            eventloop* loop = cpudispatch_
+                                  ? pool_.ev_dispatch(incoming_cpu(fd))
+                                  : pool_.ev_dispatch();
+            bfevent* bev = new bfevent(loop, fd, EPOLLIN | EPOLLET);
             bev->setcb(readcb_, writecb_,
                        std::bind(&server::tcp_eventcb_, this, bev));
+            if (accounting_) bev->set_accounting(true);
             events_.emplace_back(bev);
         }
 
+        static int incoming_cpu(int fd) {
+            int cpu = -1;
+            socklen_t len = sizeof(cpu);
+            if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == -1)
+                return -1;
+            return cpu;
+        }
+
         void tcp_eventcb_(bfevent* bev) {
             if (eventcb_) eventcb_();
             handle_close(bev);
@@ -129,6 +163,15 @@ namespace moon {
         acceptor acceptor_;  // tcp连接监听器
         int port_;           // tcp服务端端口号
         bool tcp_enable_ = false;
+        int overhigh_us_ = 0;  // 0为不启用过载保护
+        int overlow_us_ = 0;
+        int maxready_ = 0;
+        bool overloaded_ = false;
+        timerevent* overtimer_ = nullptr;  // 暂停接受期间定时检查是否恢复
+        watchdog* dog_ = nullptr;
+        bool accounting_ = false;
+        bool cpudispatch_ = false;
+        std::vector<int> loopcpus_;  // 各从reactor绑定的cpu
         std::list<base_event*> events_;
         // tcp连接建立后设置事件的回调函数
         RCallback readcb_;  // 会当读事件发生时触发
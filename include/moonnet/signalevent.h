@@ -38,9 +38,11 @@ Author: MoonforDream
 
 #include "base_event.h"
 #include <functional>
+#include <mutex>
 #include <unistd.h>
 #include <vector>
 #include <signal.h>
+#include <sys/signalfd.h>
 
 /** 弃用api
  * start->enable_listen
@@ -51,21 +53,32 @@ namespace moon {
 
     class eventloop;
     class event;
+    struct sigcenter;
 
+    // 基于signalfd的信号事件：同一信号可被多个实例(可在不同loop)订阅，
+    // 各实例在自己的loop上监听共享的signalfd，读取方将一批信号投递给各订阅者
     class signalevent : public base_event {
     public:
         using Callback = std::function<void(int)>;
+        // 带发送者pid/uid、si_code、SIGCHLD的子进程状态等信息
+        using ICallback = std::function<void(const signalfd_siginfo&)>;
 
         signalevent(eventloop* base);
         ~signalevent();
         eventloop* getloop() const override;
+        // 订阅信号，并在调用线程中屏蔽它；落到未屏蔽线程的该信号会被转投给signalfd
         void add_signal(int signo);
         void add_signal(const std::vector<int>& signals);
+        void del_signal(int signo);  // 取消订阅，信号仍保持屏蔽
         void setcb(const Callback& cb);
+        void setinfocb(const ICallback& cb);
         /* void start();
         void stop(); */
         void disable_cb() override;
         Callback getcb();
+        // 在调用线程屏蔽已订阅过的信号，库创建的线程启动时调用，
+        // 使订阅的信号只能由signalfd取走；从未订阅时不做任何事
+        static void block_subscribed();
 
         /** v1.0.1 **/
         void update_ep() override;
@@ -74,15 +87,25 @@ namespace moon {
         void close() override { del_listen(); }
 
     private:
-        static void handle_signal(int signo);
+        friend struct sigcenter;
+        void post(const signalfd_siginfo& info);  // 由读取signalfd的loop投递
         void handle_read();
+        void handle_signal();  // 共享signalfd可读
 
     private:
         eventloop* loop_;
-        int pipe_fd_[2];  // 管道的读写端
+        int evfd_;  // 有待处理信号时可读
         event* ev_;
+        sigcenter* center_ = nullptr;  // 首次订阅时获取
+        int sigfd_ = -1;               // 共享signalfd的副本
+        event* sigev_ = nullptr;       // 在本loop上监听共享的signalfd
+        bool listening_ = false;
         Callback cb_;
-        static signalevent* sigev_;  // 单例实例
+        ICallback infocb_;
+        std::mutex mutex_;
+        std::vector<signalfd_siginfo> pending_;
+        std::vector<signalfd_siginfo> handling_;
+        std::vector<int> signals_;  // 已订阅的信号
     };
 
 }  // namespace moon
@@ -0,0 +1,68 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _SOCKOPTS_H_
+#define _SOCKOPTS_H_
+
+#include <sys/socket.h>
+
+namespace moon {
+
+    // TCP套接字参数配置，值为0的项保持系统默认
+    struct sockopts {
+        int backlog = SOMAXCONN;  // listen队列长度
+        bool reuseport = true;    // SO_REUSEPORT，SO_REUSEADDR始终开启
+        bool nodelay = true;      // TCP_NODELAY
+        int sndbuf = 0;           // SO_SNDBUF，设置后关闭内核自动调整
+        int rcvbuf = 0;           // SO_RCVBUF，须在listen前设置才影响窗口扩大因子
+        // TCP_NOTSENT_LOWAT：内核中未发送数据超过该值即不可写，
+        // 多余数据留在outbuff_，使水位线与背压能感知到
+        int notsent_lowat = 0;
+        int defer_accept = 0;  // TCP_DEFER_ACCEPT：等待首个数据的秒数
+        int fastopen = 0;      // TCP_FASTOPEN：待处理TFO请求队列长度
+        bool quickack = false;  // TCP_QUICKACK：关闭延迟确认
+        // keepidle>0时开启SO_KEEPALIVE，空闲keepidle秒后每keepintvl秒探测，
+        // keepcnt次无响应断开
+        int keepidle = 0;
+        int keepintvl = 0;
+        int keepcnt = 0;
+
+        // 应用于监听套接字：缓冲区、defer accept、fast open，返回是否全部成功
+        bool apply_listen(int fd) const;
+        // 应用于已建立连接：nodelay、notsent_lowat、quickack、keepalive
+        bool apply_conn(int fd) const;
+    };
+
+}  // namespace moon
+
+#endif
@@ -34,11 +34,16 @@ Author: MoonforDream
 #ifndef _THREADPOOL_H_
 #define _THREADPOOL_H_
 
-#define DEFAULT_TIME 10
+#define DEFAULT_TIME 10            // 空闲线程超过该秒数退出(不少于最小线程数)
+#define POOL_GROW_WAIT_US 1000     // 任务排队超过该微秒数且无空闲线程时扩容
+#define POOL_ADJUST_MSEC 100       // 管理线程检查间隔
 
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <queue>
+#include <list>
 #include <thread>
 #include <vector>
 #include <mutex>
@@ -49,37 +54,57 @@ namespace moon {
 
     class threadpool {
     public:
-        threadpool(int num)
-            : threads(std::vector<std::thread>(num)),
-              min_thr_num(num),
-              live_num(num) {
+        // num为最小线程数，maxnum为最大线程数，0时为cpu核数+1(不小于num)
+        threadpool(int num, int maxnum = 0) : min_thr_num(num) {
+            max_thr_num = maxnum > 0 ? maxnum
+                                     : (int)std::thread::hardware_concurrency() + 1;
+            if (max_thr_num < min_thr_num) max_thr_num = min_thr_num;
             init();
         }
         ~threadpool() { t_shutdown(); }
         // 初始化线程池
         void init();
-        // 销毁线程池并释放资源
+        // 销毁线程池：不再接受任务，执行完队列中的任务后回收所有线程
         void t_shutdown();
         // 各任务线程入口函数
         void t_task();
         // 管理线程入口函数
         void adjust_task();
-        // 添加任务
+        // 添加任务，线程池已关闭或队列已满时返回false
         template <typename _Fn, typename... _Args>
-        void add_task(_Fn&& fn, _Args&&... args);
+        bool add_task(_Fn&& fn, _Args&&... args);
+        void set_maxqueue(size_t n);  // 队列上限，0为不限
+        int getthreads();             // 当前线程数
+        int getidle();                // 空闲线程数
+        size_t getpending();          // 排队任务数
+        uint64_t getwait_us() const;  // 任务排队时间的滑动平均(微秒)
+        uint64_t getcompleted() const;  // 已完成任务数
 
     private:
-        std::thread adjust_thr;                   // 管理线程
-        std::vector<std::thread> threads;         // 线程数组
-        std::queue<std::function<void()>> tasks;  // 任务队列
-        std::mutex mx;                            // 线程池锁
-        std::condition_variable task_cv;          // 任务通知条件变量
-        int min_thr_num = 0;                      // 线程池最小线程数
-        int max_thr_num = 0;                      // cpu核数的2n+1
-        std::atomic<int> run_num;  // 线程池中正在执行任务的线程数
-        std::atomic<int> live_num;  // 线程池空闲线程数
-        std::atomic<int> exit_num;  // 线程池要销毁线程数
-        bool shutdown = false;  // 线程池状态，true为运行，false为关闭
+        struct item {
+            std::function<void()> fn;
+            uint64_t enqueue_us;  // 入队时间
+        };
+        static uint64_t now_us();
+        void spawn();  // 持锁调用，新增一个工作线程
+        void reap();   // 回收已退出的线程
+
+    private:
+        std::thread adjust_thr;              // 管理线程
+        std::list<std::thread> threads;      // 线程数组
+        std::vector<std::thread::id> exited;  // 已退出待回收的线程
+        std::deque<item> tasks;              // 任务队列
+        std::mutex mx;                       // 线程池锁
+        std::condition_variable task_cv;     // 任务通知条件变量
+        std::condition_variable adjust_cv;   // 唤醒管理线程(关闭时)
+        int min_thr_num = 0;                 // 线程池最小线程数
+        int max_thr_num = 0;                 // 线程池最大线程数
+        int live_num = 0;                    // 存活线程数，mx保护
+        int idle_num = 0;                    // 等待任务的线程数，mx保护
+        size_t max_queue = 0;
+        std::atomic<uint64_t> wait_us{0};
+        std::atomic<uint64_t> completed{0};
+        bool shutdown = false;  // 线程池状态，true为关闭
     };
 
 }  // namespace moon
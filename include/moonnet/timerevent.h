@@ -62,6 +62,8 @@ namespace moon {
         int getfd() const;
         eventloop* getloop() const override;
         void setcb(const Callback& cb);
+        // 以新的超时时间重新计时，timeout_ms为0时停止计时
+        void reset(int timeout_ms);
         /* void start();
         void stop(); */
         void close() override { del_listen(); }
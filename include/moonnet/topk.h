@@ -0,0 +1,92 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _TOPK_H_
+#define _TOPK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace moon {
+
+    // 读取时间戳计数器，非x86平台退回单调时钟纳秒
+    inline uint64_t rdcycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+    uint64_t cycles_to_ns(uint64_t cycles);  // 按运行期间测得的频率换算
+
+    // 排行项，cost可能被高估，至多高估error
+    struct talker {
+        const void* key;
+        int fd;
+        uint64_t cost;
+        uint64_t error;
+    };
+
+    // Space-Saving重量级元素统计：固定k个槽位，找出累计cost最高的key
+    // 加锁保护，可在其他线程查询
+    class topk {
+    public:
+        explicit topk(size_t k);
+        void add(const void* key, int fd, uint64_t cost);
+        void remove(const void* key);  // key失效时移除，避免被新对象继承
+        std::vector<talker> top(size_t n) const;  // 按cost降序
+        uint64_t total() const;  // 所有key的累计cost
+        void reset();            // 清空，用于按时间窗口统计
+        topk(const topk&) = delete;
+        topk& operator=(const topk&) = delete;
+
+    private:
+        mutable std::mutex mutex_;
+        size_t k_;
+        uint64_t total_ = 0;
+        std::vector<talker> slots_;
+        std::unordered_map<const void*, size_t> index_;
+    };
+
+}  // namespace moon
+
+#endif
@@ -38,20 +38,44 @@ Author: MoonforDream
 #include "base_event.h"
 #include "buffer.h"
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 namespace moon {
 
     class eventloop;
     class event;
 
+    // udpevent收发统计
+    struct udpstats {
+        size_t rxpkts = 0;
+        size_t rxbytes = 0;
+        size_t txpkts = 0;
+        size_t txbytes = 0;
+        size_t drops = 0;      // 因队列满或发送错误丢弃的数据报数
+        size_t truncated = 0;  // 超过mtu被截断的数据报数
+    };
+
     // UDP 处理类
     class udpevent : public base_event {
     public:
         using Callback = std::function<void()>;
         using RCallback = std::function<void(const sockaddr_in&, udpevent*)>;
+        // 逐个数据报回调，data仅在回调期间有效
+        using DCallback = std::function<void(const char*, size_t,
+                                             const sockaddr_in&, udpevent*)>;
+        // 新会话回调：session已connect到对端，data为该对端的首个数据报
+        using NCallback =
+            std::function<void(udpevent* session, const char*, size_t)>;
+        using LCallback = std::function<eventloop*()>;  // 为新会话选择loop
         udpevent(eventloop* base, int port);
+        // 会话模式：绑定port并connect到peer，只接收该对端的数据报
+        udpevent(eventloop* base, int port, const sockaddr_in& peer);
         ~udpevent();
 
         buffer* getinbuff();
@@ -59,6 +83,11 @@ namespace moon {
         void setcb(const RCallback& rcb, const Callback& ecb);
         void setrcb(const RCallback& rcb);
         void setecb(const Callback& ecb);
+        // 设置后使用recvmmsg批量接收，每个数据报单独回调，不再写入inbuff_
+        // mtu为单个数据报最大长度(不超过64KB)，batch为单次recvmmsg的数据报数
+        void setdcb(const DCallback& dcb, size_t mtu = 2048, int batch = 32);
+        size_t gettruncated() const;  // 超过mtu被截断的数据报数
+        const udpstats& getstats() const;  // 仅在所属loop线程读取准确
         void init_sock(int port);
         void enable_listen() override;  // 开始监听
         void del_listen() override;     // 停止监听
@@ -66,8 +95,34 @@ namespace moon {
         size_t receive(char* data, size_t len);
         std::string receive(size_t len);
         std::string receive();
+        // 不复制地访问输入数据
+        const char* peek() const;
+        size_t readbytes() const;
+        void retrieve(size_t len);
         void send_to(const std::string& data,
                      const sockaddr_in& addr);  // 发送数据到指定地址
+        void send_to(const char* data, size_t len, const sockaddr_in& addr);
+        // 将iov拼接为一个数据报发送
+        void send_to(const iovec* iov, int iovcnt, const sockaddr_in& addr);
+        // 开启后send_to只入队，本轮迭代结束时用sendmmsg统一发送
+        void set_sendbatch(bool on);
+        // 发送队列上限(字节)，超出时丢弃新数据报
+        void set_sendlimit(size_t bytes);
+        size_t getqueued() const;  // 发送队列中的数据报数
+        size_t getdrops() const;   // 因队列满或发送错误丢弃的数据报数
+        // 会话模式：新对端的首个数据报到达时创建已连接的会话socket，
+        // 由pick选择的loop处理该对端后续数据，本socket只处理新对端
+        void set_session(const NCallback& ncb, const LCallback& pick);
+        bool connected() const;          // 是否为已连接的会话
+        const sockaddr_in& getpeer() const;
+        void send(const char* data, size_t len);  // 会话发送，无需地址
+        // UDP_SEGMENT：发送队列中连续、同目标、等长的数据报合并为一次发送
+        bool set_gso(bool on);
+        // UDP_GRO：内核合并接收，按段长拆分后逐个回调，需配合setdcb使用
+        bool set_gro(bool on);
+        // 为本端口的SO_REUSEPORT组挂载CBPF：在cpus[i]上收到的数据报交给组内
+        // 第i个绑定的socket，其余按cpu取模
+        bool set_cpusteer(const std::vector<int>& cpus);
 
         void enable_read();
         void disable_read();
@@ -79,7 +134,19 @@ namespace moon {
         void close() override { del_listen(); }
 
     private:
+        void init_session(int port, const sockaddr_in& peer);
+        // 会话模式下为新对端创建会话，返回true表示数据报已交给新会话
+        // 将对端的数据报(GRO合并时按seg拆分)交给其会话，必要时创建会话
+        bool divert(const char* data, size_t len, size_t seg,
+                    const sockaddr_in& peer);
         void handle_receive();  // 处理接收事件
+        void handle_receive_batch();
+        void handle_send();  // EPOLLOUT时继续发送队列
+        void handle_flush() override;
+        void enqueue(const iovec* iov, int iovcnt, size_t len,
+                     const sockaddr_in& addr);
+        void flush_queue();
+        bool send_plain(size_t count);  // 不经GSO逐个发送队首count个数据报
     private:
         eventloop* loop_;
         int fd_;
@@ -87,6 +154,38 @@ namespace moon {
         buffer inbuff_;
         RCallback receive_cb_;
         Callback event_cb_;
+        DCallback dgram_cb_;
+        size_t mtu_ = 0;
+        int batch_ = 0;
+        udpstats stats_;
+        // 监听socket与其所有会话共享的对端表，会话析构时移除自身
+        // 递归锁：转交数据报时持锁调用会话回调，回调内可析构会话
+        struct sessreg {
+            std::recursive_mutex mutex;
+            std::unordered_map<uint64_t, udpevent*> peers;
+        };
+        std::shared_ptr<sessreg> sessions_;
+        NCallback session_cb_;
+        LCallback pick_;
+        sockaddr_in peer_;
+        uint64_t peerkey_ = 0;
+        int port_ = -1;
+        bool connected_ = false;
+        // 发送队列：数据报内容连续存放在sendbuf_中
+        struct dgram {
+            size_t off;
+            size_t len;
+            sockaddr_in addr;
+        };
+        std::vector<char> sendbuf_;
+        std::vector<dgram> sendq_;
+        size_t sendhead_ = 0;
+        size_t sendlimit_ = 4 * 1024 * 1024;
+        bool sendbatch_ = false;
+        bool gso_ = false;
+        bool gro_ = false;
+        bool flushq_ = false;
+        bool writing_ = false;
         bool started_ = false;
     };
 
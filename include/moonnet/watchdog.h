@@ -0,0 +1,106 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <csignal>
+
+// 抓取loop线程调用栈所用的信号
+#define WATCHDOG_SIGNAL (SIGRTMIN + 4)
+#define WATCHDOG_MAX_FRAMES 64
+
+namespace moon {
+
+    class event;
+    class eventloop;
+
+    // 一次卡顿记录
+    struct stallinfo {
+        eventloop* loop;       // 卡住的从reactor
+        event* ev;             // 正在处理的事件，仅作标识，可能已被释放
+        int fd;                // 事件的fd，迭代末尾的刷新阶段为-1
+        uint64_t seq;          // 回调序号
+        uint64_t elapsed_us;   // 发现时回调已执行的时间
+        std::vector<std::string> backtrace;  // loop线程调用栈，抓取失败时为空
+    };
+
+    // 看门狗线程：监视eventloop的心跳，回调执行超过阈值时记录事件与调用栈
+    class watchdog {
+    public:
+        using WCallback = std::function<void(const stallinfo&)>;
+        watchdog(int threshold_ms, const WCallback& cb = nullptr);
+        ~watchdog();
+        void watch(eventloop* loop);    // 开始监视，可在loop运行时调用
+        void unwatch(eventloop* loop);  // 停止监视，loop析构时会自动调用
+        // 卡顿记录在看门狗线程回调，不能在其中调用watch/unwatch，默认输出到stderr
+        void setcb(const WCallback& cb);
+        void start();
+        void stop();
+        size_t getstalls() const;  // 已记录的卡顿次数
+        watchdog(const watchdog&) = delete;
+        watchdog& operator=(const watchdog&) = delete;
+
+    private:
+        void run();
+        void check(eventloop* loop, uint64_t& reported);
+        static void capture(eventloop* loop, std::vector<std::string>& bt);
+        static void print(const stallinfo& info);
+
+    private:
+        struct watched {
+            eventloop* loop;
+            uint64_t reported;  // 已上报的回调序号，同一次卡顿只上报一次
+        };
+        int threshold_us_;
+        int interval_ms_;
+        WCallback stallcb_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::vector<watched> loops_;
+        std::thread thread_;
+        bool running_ = false;
+        std::atomic<size_t> stalls_{0};
+    };
+
+}  // namespace moon
+
+#endif
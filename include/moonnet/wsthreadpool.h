@@ -0,0 +1,136 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _WSTHREADPOOL_H_
+#define _WSTHREADPOOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define WSDEQUE_INIT_SIZE 256  // 每个工作线程双端队列的初始容量(2的幂)
+
+namespace moon {
+
+    // Chase-Lev 工作窃取双端队列
+    // 只有所属线程可以 push/pop(底部，LIFO)，其他线程只能 steal(顶部，FIFO)
+    class wsdeque {
+    public:
+        using task = std::function<void()>;
+
+        wsdeque();
+        ~wsdeque();
+        void push(task* t);  // 仅所属线程调用，容量不足时扩容
+        task* pop();         // 仅所属线程调用
+        task* steal();       // 任意线程调用，失败或为空返回nullptr
+        bool empty() const;
+        size_t size() const;
+
+        wsdeque(const wsdeque&) = delete;
+        wsdeque& operator=(const wsdeque&) = delete;
+
+    private:
+        struct array {
+            int64_t mask;
+            std::atomic<task*>* slots;
+            explicit array(int64_t n);
+            ~array();
+            task* get(int64_t i) const;
+            void put(int64_t i, task* t);
+        };
+        array* grow(array* a, int64_t b, int64_t t);
+
+    private:
+        std::atomic<int64_t> top_;
+        char pad_[64];  // 窃取者改top_，所属线程改bottom_，分开避免伪共享
+        std::atomic<int64_t> bottom_;
+        std::atomic<array*> arr_;
+        std::vector<array*> old_;  // 扩容后的旧数组，窃取者可能仍在读，析构时释放
+    };
+
+    class wsthreadpool {
+    public:
+        using task = std::function<void()>;
+
+        explicit wsthreadpool(int tnum = -1);  // tnum为-1时取CPU核数
+        ~wsthreadpool();
+        void t_shutdown();  // 执行完已提交的任务后退出
+
+        // 在池内任务中调用时压入当前线程的双端队列，否则进入全局注入队列
+        template <typename _Fn, typename... _Args>
+        bool add_task(_Fn&& fn, _Args&&... args);
+
+        int getthreads() const;
+        size_t getpending() const;   // 尚未执行的任务数(近似值)
+        uint64_t getsteals() const;  // 累计窃取成功次数
+        uint64_t getparks() const;   // 累计休眠次数
+
+        wsthreadpool(const wsthreadpool&) = delete;
+        wsthreadpool& operator=(const wsthreadpool&) = delete;
+
+    private:
+        struct worker {
+            wsdeque dq;
+            std::thread t;
+            uint32_t seed;
+        };
+
+        bool submit(task* t);
+        void run(size_t idx);
+        task* find_task(size_t idx);
+        task* take_inject();
+        bool has_work() const;
+        void park();
+        void wake(int n);
+
+    private:
+        std::vector<worker*> workers_;
+        std::mutex injectmx_;
+        std::deque<task*> inject_;
+        std::atomic<size_t> injectsize_;
+        std::atomic<uint32_t> epoch_;  // futex字
+        std::atomic<int> idle_;
+        std::atomic<bool> shutdown_;
+        std::atomic<uint64_t> steals_;
+        std::atomic<uint64_t> parks_;
+    };
+
+}  // namespace moon
+
+#include "wsthreadpool.tpp"
+
+#endif  // !_WSTHREADPOOL_H_
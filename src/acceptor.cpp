@@ -38,7 +38,8 @@ Author: MoonforDream
 
 using namespace moon;
 
-acceptor::acceptor(int port, eventloop *base) : loop_(base), shutdown_(true) {
+acceptor::acceptor(int port, eventloop *base)
+    : loop_(base), ev_(nullptr), shutdown_(true) {
     if (port != -1) init_sock(port);
 }
 
@@ -48,10 +49,26 @@ acceptor::~acceptor() {
     close(lfd_);
 }
 
-void acceptor::init_sock(int port) {
+/**
+ * @brief Creates the listening socket and applies a socket option profile.
+ *
+ * The listener part of `opts` is applied before `listen`; the connection part is
+ * applied to every socket accepted afterwards.
+ *
+ * @param port The port to listen on.
+ * @param opts The socket option profile.
+ */
+void acceptor::init_sock(int port, const sockopts &opts) {
     int fd = Socket(AF_INET, SOCK_STREAM, 0);
     setnonblock(fd);
-    setreuse(fd);
+    if (opts.reuseport) {
+        setreuse(fd);
+    } else {
+        int on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1)
+            perr_exit("setsockopt ipreuse error");
+    }
+    opts.apply_listen(fd);
 
     struct sockaddr_in ser_addr;
     bzero(&ser_addr, sizeof(ser_addr));
@@ -60,18 +77,43 @@ void acceptor::init_sock(int port) {
     ser_addr.sin_port = htons(port);
 
     Bind(fd, (struct sockaddr *)&ser_addr, sizeof(ser_addr));
-    Listen(fd, SOMAXCONN);
+    Listen(fd, opts.backlog > 0 ? opts.backlog : SOMAXCONN);
 
     lfd_ = fd;
+    opts_ = opts;
 }
 
 void acceptor::setcb(const Callback &accept_cb) { cb_ = accept_cb; }
 
+/**
+ * @brief Installs an admission check consulted before every accepted connection.
+ *
+ * While `admit` returns false, new connections are either accepted and reset at
+ * once (`reject`), which tells clients quickly to go elsewhere, or left in the
+ * kernel backlog by stopping to listen until `listen()` is called again.
+ *
+ * @param admit The admission check; empty to admit everything.
+ * @param reject Whether to reset connections instead of pausing.
+ */
+void acceptor::setadmit(const ACallback &admit, bool reject) {
+    admit_ = admit;
+    reject_ = reject;
+}
+
+size_t acceptor::getrejected() const { return rejected_; }
+
+bool acceptor::listening() const { return !shutdown_; }
+
 void acceptor::handle_accept() {
     struct sockaddr_in cli_addr;
     socklen_t cli_len = sizeof(cli_addr);
     bzero(&cli_addr, cli_len);
     while (true) {
+        bool admit = !admit_ || admit_();
+        if (!admit && !reject_) {
+            stop();
+            break;
+        }
         int cfd = accept(lfd_, (struct sockaddr *)&cli_addr, &cli_len);
         if (cfd == -1) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -81,16 +123,26 @@ void acceptor::handle_accept() {
                 break;
             }
         }
+        if (!admit) {
+            // SO_LINGER为0时close发送RST，不进入TIME_WAIT
+            struct linger lg = {1, 0};
+            setsockopt(cfd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+            close(cfd);
+            ++rejected_;
+            continue;
+        }
         setnonblock(cfd);
-        settcpnodelay(cfd);
+        opts_.apply_conn(cfd);
         if (cb_) cb_(cfd);
     }
 }
 
 void acceptor::listen() {
     if (!shutdown_) return;
-    ev_ = new event(loop_, lfd_, EPOLLIN | EPOLLET);
-    ev_->setcb(std::bind(&acceptor::handle_accept, this), NULL, NULL);
+    if (!ev_) {
+        ev_ = new event(loop_, lfd_, EPOLLIN | EPOLLET);
+        ev_->setcb(std::bind(&acceptor::handle_accept, this), NULL, NULL);
+    }
     loop_->add_event(ev_);
     shutdown_ = false;
 }
@@ -34,11 +34,19 @@ Author: MoonforDream
 
 #include "bfevent.h"
 #include <cstdio>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
 #include "event.h"
 #include "eventloop.h"
+#include "topk.h"
 
 using namespace moon;
 
+// 缓冲转发时peer待发送数据的高低水位
+#define FWD_HIGH (1024 * 1024)
+#define FWD_LOW (256 * 1024)
+
 bfevent::bfevent(eventloop *base,int fd,uint32_t events)
 :loop_(base),fd_(fd),ev_(new event(base,fd,events)){
     ev_->setcb(std::bind(&bfevent::handle_read,this),
@@ -49,7 +57,13 @@ bfevent::bfevent(eventloop *base,int fd,uint32_t events)
 
 
 bfevent::~bfevent(){
+    if(flushq_) loop_->del_pending_flush(this);
+    if(acct_){
+        acct_->dead=true;
+        if(loop_->gettopk()) loop_->gettopk()->remove(this);
+    }
     close_event();
+    clear_segs();
     delete ev_;
 }
 
@@ -130,10 +144,10 @@ void bfevent::del_listen(){
     if(inbuff_.readbytes()>0){
         if(readcb_) readcb_(this);
     }
-    if(outbuff_.readbytes()>0){
+    if(has_pending()){
         if(!ev_->writeable()) ev_->enable_write();
     }
-    if(outbuff_.readbytes()==0) ev_->disable_write();
+    if(!has_pending()) ev_->disable_write();
     ev_->del_listen();
     closed_=true;
 }
@@ -153,19 +167,35 @@ void bfevent::enable_listen(){
  * If the event is not currently writable and the output buffer is empty, it tries to write directly.
  * Otherwise, it appends the remaining data to the output buffer and enables write events.
  * Handles partial writes and ensures that the write callback is invoked when all data is sent.
+ * While file segments queued by `send_file` are pending, the data is only appended so that it
+ * leaves the socket after them. A corked event only appends and leaves the write to the end of
+ * the loop iteration.
  *
  * @param data Pointer to the data to be sent.
  * @param len The length of the data to be sent in bytes.
  */
 void bfevent::sendout(const char* data, size_t len){
-    ssize_t n=0;
-    ssize_t relen=len;
+    if(corked_){
+        outbuff_.append(data, len);
+        queue_flush();
+        check_highwater();
+        return;
+    }
+    if(!segs_.empty()){
+        outbuff_.append(data, len);
+        if(!writeable()) ev_->enable_write();
+        check_highwater();
+        return;
+    }
+    size_t relen=len;
     if(!writeable()&&outbuff_.readbytes()==0){
-        n=write(fd_,data,len);
+        ssize_t n=write(fd_,data,len);
+        count_out(n);
         if(n>=0){
-            relen-=len;
-            if(relen==0&&writecb_){
-                writecb_();
+            relen-=n;
+            data+=n;
+            if(relen==0){
+                if(writecb_) writecb_();
                 return;
             }
         }else{
@@ -181,22 +211,23 @@ void bfevent::sendout(const char* data, size_t len){
         size_t wbytes=outbuff_.readbytes();
         vec[0].iov_base=const_cast<char*>(outbuff_.peek());
         vec[0].iov_len=wbytes;
-        vec[1].iov_base=const_cast<char*>(data+n);
+        vec[1].iov_base=const_cast<char*>(data);
         vec[1].iov_len=relen;
         ssize_t wvn=writev(fd_,vec,2);
+        count_out(wvn);
         if(wvn>=0){
             size_t tlen=wbytes+relen;
-            if(wvn<tlen){
-                if(wvn<wbytes) outbuff_.retrieve(wvn);
+            if(static_cast<size_t>(wvn)<tlen){
+                if(static_cast<size_t>(wvn)<wbytes) drain_out(wvn);
                 else{
-                    outbuff_.reset();
+                    drain_out(wbytes);
                     size_t diff=wvn-wbytes;
                     relen-=diff;
-                    data+=(n+diff);
+                    data+=diff;
                 }
             }
             else{
-                outbuff_.reset();
+                drain_out(wbytes);
                 if(writecb_) writecb_();
                 return;
             }
@@ -211,6 +242,7 @@ void bfevent::sendout(const char* data, size_t len){
         outbuff_.append(data, relen);
         if(!writeable())
             ev_->enable_write();
+        check_highwater();
     }
 }
 
@@ -226,6 +258,283 @@ void bfevent::sendout(const std::string& data){
     sendout(data.c_str(), data.size());
 }
 
+/**
+ * @brief Sends several pieces of data as one contiguous stream.
+ *
+ * When nothing is queued ahead of it the pieces go out with a single `writev`
+ * straight from the caller's memory; only what the socket does not accept is
+ * copied into `outbuff_`. Otherwise each piece is appended behind the pending data.
+ *
+ * @param iov The pieces to send, in order.
+ * @param iovcnt The number of pieces.
+ */
+void bfevent::sendout(const struct iovec* iov, int iovcnt){
+    size_t total=0;
+    for(int i=0;i<iovcnt;++i) total+=iov[i].iov_len;
+    if(total==0) return;
+    size_t done=0;
+    if(!corked_&&segs_.empty()&&!writeable()&&outbuff_.readbytes()==0){
+        ssize_t n=writev(fd_,iov,iovcnt);
+        count_out(n);
+        if(n>=0){
+            done=n;
+            if(done==total){
+                if(writecb_) writecb_();
+                return;
+            }
+        }else if(errno!=EAGAIN&&errno!=EWOULDBLOCK){
+            perror("sendout error");
+            return;
+        }
+    }
+    for(int i=0;i<iovcnt;++i){
+        size_t l=iov[i].iov_len;
+        if(done>=l){
+            done-=l;
+            continue;
+        }
+        outbuff_.append(static_cast<const char*>(iov[i].iov_base)+done, l-done);
+        done=0;
+    }
+    if(corked_) queue_flush();
+    else if(!writeable()) ev_->enable_write();
+    check_highwater();
+}
+
+/**
+ * @brief Queues a file range for zero-copy transmission.
+ *
+ * The range [`offset`, `offset`+`len`) of `fd` is sent with `sendfile(2)`, so the
+ * file contents never enter user memory. The segment is ordered after everything
+ * already handed to `sendout`, and data sent afterwards goes out after it. When the
+ * output path is idle the transfer starts immediately, the remainder is drained by
+ * `handle_write` when the socket becomes writable again.
+ *
+ * @param fd The file descriptor to read from. Regular files go through `sendfile`;
+ * other readable sources that support `pread` are copied through user memory.
+ * @param offset The file offset of the first byte to send.
+ * @param len The number of bytes to send.
+ * @param autoclose Whether `fd` is closed once the segment is sent or the event is closed.
+ */
+void bfevent::send_file(int fd, off_t offset, size_t len, bool autoclose){
+    outseg seg{fd, offset, len, outpos_ + outbuff_.readbytes(), autoclose,
+               nullptr, nullptr, false, std::string()};
+    if(!has_pending()&&!writeable()&&!corked_){
+        int ret=send_seg(seg);
+        if(ret<0){
+            if(autoclose) ::close(fd);
+            return;
+        }
+        if(seg.len==0){
+            if(autoclose) ::close(fd);
+            if(writecb_) writecb_();
+            return;
+        }
+    }
+    segs_.push_back(std::move(seg));
+    if(corked_) queue_flush();
+    else if(!writeable()) ev_->enable_write();
+    check_highwater();
+}
+
+/**
+ * @brief Enables `MSG_ZEROCOPY` transmission for large payloads.
+ *
+ * Sets `SO_ZEROCOPY` on the socket. Payloads handed to `sendout_zc` whose length is
+ * at least `threshold` are then sent without copying them into the kernel.
+ *
+ * @param threshold Minimum payload length for zero-copy sends, 0 disables it.
+ *
+ * @return `true` on success, `false` if the kernel does not support `SO_ZEROCOPY`.
+ */
+bool bfevent::set_zerocopy(size_t threshold){
+    if(threshold==0){
+        zcthreshold_=0;
+        return true;
+    }
+    int opt=1;
+    if(setsockopt(fd_,SOL_SOCKET,SO_ZEROCOPY,&opt,sizeof(opt))==-1){
+        perror("setsockopt zerocopy error");
+        return false;
+    }
+    zcthreshold_=threshold;
+    return true;
+}
+
+/**
+ * @brief Sends caller-owned memory, with `MSG_ZEROCOPY` when it is large enough.
+ *
+ * Payloads below the threshold (or when zero-copy is off) are sent through
+ * `sendout` and `release` is called right away. Otherwise the pages of `data` are
+ * pinned by the kernel: `data` must stay valid and unchanged until `release` runs,
+ * which happens once the error queue reports completion of every send covering it.
+ *
+ * Closing the event is not a completion: the kernel keeps transmitting queued
+ * data after `close`. If sends are still outstanding at close, the connection is
+ * aborted with an RST (see `abort_zc`) so the send queue is discarded, and only
+ * then is `release` called; data not yet acknowledged by the peer is lost. To
+ * deliver everything, wait for the release callbacks before closing.
+ *
+ * @param data Pointer to the data to be sent.
+ * @param len The length of the data to be sent in bytes.
+ * @param release Callback invoked when the kernel no longer references `data`,
+ * or after the connection was aborted on close.
+ */
+void bfevent::sendout_zc(const char* data, size_t len, const Callback& release){
+    if(zcthreshold_==0||zccopied_||len<zcthreshold_){
+        sendout(data, len);
+        if(release) release();
+        return;
+    }
+    outseg seg{-1, 0, len, outpos_ + outbuff_.readbytes(), false, data,
+               release, false, std::string()};
+    if(!has_pending()&&!writeable()&&!corked_){
+        if(send_seg(seg)<0){
+            if(seg.release) seg.release();
+            return;
+        }
+        if(seg.len==0) return;
+    }
+    segs_.push_back(std::move(seg));
+    if(corked_) queue_flush();
+    else if(!writeable()) ev_->enable_write();
+    check_highwater();
+}
+
+/**
+ * @brief Bounds the output queue with a high/low water mark pair.
+ *
+ * When the bytes waiting to be sent (`outbuff_` plus queued segments) grow past
+ * `high`, `hcb` is invoked once and the pause target, if any, stops reading. When
+ * `handle_write` later drains them to `low` or below, `lcb` is invoked and the
+ * target resumes reading.
+ *
+ * @param high The high water mark in bytes, 0 disables the check.
+ * @param low The low water mark in bytes, clamped to `high`.
+ * @param hcb Callback invoked with the pending byte count on crossing `high`.
+ * @param lcb Callback invoked with the pending byte count on draining to `low`.
+ */
+void bfevent::set_watermark(size_t high, size_t low, const WCallback& hcb,
+                            const WCallback& lcb){
+    highwater_=high;
+    lowwater_=low>high?high:low;
+    highcb_=hcb;
+    lowcb_=lcb;
+    if(highwater_==0){
+        if(abovehigh_&&pausetarget_) pausetarget_->resume_read(PAUSE_PEER);
+        abovehigh_=false;
+    }
+}
+
+/**
+ * @brief Sets the connection whose reads are paused while this one is above the
+ * high water mark.
+ *
+ * A proxy passes the upstream side so a slow downstream reader throttles the
+ * producer; passing `this` throttles a connection that writes what it reads. The
+ * target must outlive this event or be reset with `nullptr` first.
+ *
+ * @param target The `bfevent` to pause, or `nullptr` for none.
+ */
+void bfevent::set_pausetarget(bfevent* target){
+    if(abovehigh_){
+        if(pausetarget_) pausetarget_->resume_read(PAUSE_PEER);
+        if(target) target->pause_read(PAUSE_PEER);
+    }
+    pausetarget_=target;
+}
+
+
+size_t bfevent::pending_bytes() const{
+    size_t n=outbuff_.readbytes();
+    for(auto &seg:segs_) n+=seg.len;
+    return n;
+}
+
+/**
+ * @brief Bounds the input buffer for applications that consume asynchronously.
+ *
+ * Once `inbuff_` holds `high` bytes or more after a read callback, `handle_read`
+ * stops draining the socket and drops `EPOLLIN`, so the kernel receive queue fills
+ * and TCP flow control pushes back on the sender. Reading resumes when the
+ * application consumes the buffer down to `low` through `receive` (or reports
+ * direct consumption with `update_inlimit`). Consumption must happen on the
+ * event's loop thread.
+ *
+ * @param high The input limit in bytes, 0 disables it.
+ * @param low The resume mark in bytes, clamped to `high`.
+ */
+void bfevent::set_inlimit(size_t high, size_t low){
+    inhigh_=high;
+    inlow_=low>high?high:low;
+    update_inlimit();
+}
+
+
+void bfevent::update_inlimit(){
+    if(!(readpause_&PAUSE_INPUT)) return;
+    if(inhigh_==0||inbuff_.readbytes()<=inlow_) resume_read(PAUSE_INPUT);
+}
+
+/**
+ * @brief Enables or disables automatic corking.
+ *
+ * While corked, `sendout` (and `send_file`/`sendout_zc`) only queue data and the
+ * owning `eventloop` flushes the connection once at the end of the current
+ * iteration, so several small responses produced by one read callback leave in a
+ * single write. Turning corking off flushes immediately.
+ *
+ * @param on Whether to cork the connection.
+ */
+void bfevent::set_cork(bool on){
+    corked_=on;
+    if(!on&&has_pending()) flush();
+}
+
+/**
+ * @brief Sends queued output now.
+ *
+ * Called at the end of an iteration for corked events, or directly by the user.
+ * Writes as much as the socket accepts and waits for `EPOLLOUT` for the rest.
+ */
+void bfevent::flush(){
+    if(closed_||writeable()||!has_pending()) return;
+    handle_write();
+    if(has_pending()&&!closed_&&!writeable()) ev_->enable_write();
+}
+
+void bfevent::handle_flush(){
+    flushq_=false;
+    flush();
+}
+
+// 发送新追加到outbuff_的数据
+void bfevent::start_write(){
+    if(corked_) queue_flush();
+    else if(!writeable()) flush();
+}
+
+void bfevent::queue_flush(){
+    if(flushq_||writeable()) return;
+    flushq_=true;
+    loop_->add_pending_flush(this);
+}
+
+/**
+ * @brief Switches between per-read and per-readiness read callbacks.
+ *
+ * By default `readcb_` runs after every successful read, so a large burst is parsed
+ * several times while still incomplete. In batch mode the socket is drained first and
+ * `readcb_` runs once per readiness notification.
+ *
+ * @param on Whether to enable batch reads.
+ * @param budget The maximum number of bytes read per notification before yielding.
+ */
+void bfevent::set_batchread(bool on, size_t budget){
+    batchread_=on;
+    readbudget_=budget>0?budget:1;
+}
+
 /**
  * @brief Receives data from the event's input buffer into a provided buffer.
  *
@@ -237,7 +546,62 @@ void bfevent::sendout(const std::string& data){
  * @return The number of bytes actually received and copied into `data`.
  */
 size_t bfevent::receive(char* data, size_t len){
-    return inbuff_.remove(data, len);
+    size_t n=inbuff_.remove(data, len);
+    update_inlimit();
+    return n;
+}
+
+/**
+ * @brief Returns a pointer to the readable input data without copying it.
+ *
+ * The `readbytes()` bytes starting at the returned pointer are contiguous. The pointer
+ * stays valid until the input buffer is consumed or more data is read.
+ *
+ * @return Pointer to the first readable byte.
+ */
+const char* bfevent::peek() const{
+    return inbuff_.peek();
+}
+
+size_t bfevent::readbytes() const{
+    return inbuff_.readbytes();
+}
+
+/**
+ * @brief Consumes input data that was accessed through `peek()`.
+ *
+ * @param len The number of bytes to discard from the input buffer.
+ */
+void bfevent::retrieve(size_t len){
+    inbuff_.retrieve(len);
+    update_inlimit();
+}
+
+/**
+ * @brief Moves all input data into another connection's output queue.
+ *
+ * When the peer has no buffered output, the input buffer is swapped with the peer's
+ * output buffer and nothing is copied; otherwise the data is appended behind the
+ * pending output. The peer then writes as `sendout` would. Passing `this` echoes the
+ * input back. Both events must belong to the same `eventloop`.
+ *
+ * @param peer The connection that sends the data.
+ *
+ * @return The number of bytes moved.
+ */
+size_t bfevent::transfer_to(bfevent* peer){
+    size_t n=inbuff_.readbytes();
+    if(n==0||peer->closed_) return 0;
+    if(peer->outbuff_.readbytes()==0){
+        inbuff_.swap(peer->outbuff_);
+    }else{
+        peer->outbuff_.append(inbuff_.peek(), n);
+        inbuff_.retrieve(n);
+    }
+    update_inlimit();
+    peer->start_write();
+    peer->check_highwater();
+    return n;
 }
 
 /**
@@ -250,7 +614,9 @@ size_t bfevent::receive(char* data, size_t len){
  * @return A `std::string` containing the received data.
  */
 std::string bfevent::receive(size_t len){
-    return inbuff_.remove(len);
+    std::string data=inbuff_.remove(len);
+    update_inlimit();
+    return data;
 }
 
 /**
@@ -261,7 +627,506 @@ std::string bfevent::receive(size_t len){
  * @return A `std::string` containing all received data.
  */
 std::string bfevent::receive(){
-    return inbuff_.remove(inbuff_.readbytes());
+    std::string data=inbuff_.remove(inbuff_.readbytes());
+    update_inlimit();
+    return data;
+}
+
+
+/**
+ * @brief Forwards all further input of this connection to `peer`.
+ *
+ * Bytes are moved with `splice(2)` from this socket into a pipe and from the pipe into
+ * the peer's socket, so they never enter user space. When the pipe cannot be created
+ * or the socket does not support splicing, input is moved into the peer's output
+ * buffer with `transfer_to`, which swaps buffers instead of copying when possible.
+ * In both modes reading pauses while the peer cannot keep up and resumes from the
+ * peer's write handler. The read callback is not invoked while forwarding; end of
+ * stream and errors still reach the event callback. Call it on both connections for
+ * a bidirectional tunnel. Both must belong to the same `eventloop`, and the peer
+ * should not send other data meanwhile.
+ *
+ * @param peer The destination connection, or `nullptr` to stop forwarding.
+ *
+ * @return Whether the zero-copy splice path is used.
+ */
+bool bfevent::forward_to(bfevent* peer){
+    stop_forward();
+    if(!peer||closed_||peer->closed_) return false;
+    if(peer->fwdsrc_) peer->fwdsrc_->stop_forward();
+    fwdpeer_=peer;
+    peer->fwdsrc_=this;
+    // 已缓冲的输入先按序交给peer
+    if(inbuff_.readbytes()>0) transfer_to(peer);
+    splice_=pipe2(pipefd_, O_NONBLOCK|O_CLOEXEC)==0;
+    if(!splice_) perror("pipe2");
+    handle_forward();
+    return splice_;
+}
+
+
+void bfevent::stop_forward(){
+    if(!fwdpeer_) return;
+    // 管道中剩余的数据转入peer的发送缓冲区
+    if(pipebytes_>0&&!fwdpeer_->closed_){
+        char buf[IOBUF];
+        ssize_t n;
+        while(pipebytes_>0&&(n=read(pipefd_[0], buf, sizeof(buf)))>0){
+            pipebytes_-=n;
+            fwdpeer_->sendout(buf, n);
+        }
+    }
+    if(pipefd_[0]!=-1){
+        ::close(pipefd_[0]);
+        ::close(pipefd_[1]);
+        pipefd_[0]=pipefd_[1]=-1;
+    }
+    pipebytes_=0;
+    splice_=false;
+    fwdpeer_->fwdsrc_=nullptr;
+    fwdpeer_=nullptr;
+    resume_read(PAUSE_FORWARD);
+}
+
+
+/**
+ * @brief Moves readable input to the forwarding peer until the socket is drained or the
+ * peer is full.
+ */
+void bfevent::handle_forward(){
+    if(!splice_){
+        while(fwdpeer_){
+            int errnum=0;
+            int n=inbuff_.readiov(fd_, errnum);
+            count_in(n);
+            if(n>0){
+                transfer_to(fwdpeer_);
+                if(fwdpeer_&&fwdpeer_->pending_bytes()>=FWD_HIGH){
+                    pause_read(PAUSE_FORWARD);
+                    break;
+                }
+            }else if(n==0){
+                if(eventcb_) eventcb_();
+                break;
+            }else{
+                if(errno==EAGAIN||errno==EWOULDBLOCK) break;
+                perror("read error");
+                if(eventcb_) eventcb_();
+                break;
+            }
+        }
+        return;
+    }
+    bool moved=false;
+    while(fwdpeer_){
+        ssize_t n=splice(fd_, nullptr, pipefd_[1], nullptr, IOBUF,
+                         SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+        count_in(n);
+        if(n>0){
+            moved=true;
+            pipebytes_+=n;
+            if(!drain_pipe()){
+                pause_read(PAUSE_FORWARD);
+                if(!fwdpeer_->writeable()) fwdpeer_->ev_->enable_write();
+                return;
+            }
+        }else if(n==0){
+            if(pipebytes_>0) drain_pipe();
+            if(eventcb_) eventcb_();
+            return;
+        }else{
+            if(errno==EINTR) continue;
+            if(errno==EAGAIN||errno==EWOULDBLOCK) return;
+            if(errno==EINVAL&&!moved&&pipebytes_==0){
+                // 不支持splice，退回缓冲转发
+                ::close(pipefd_[0]);
+                ::close(pipefd_[1]);
+                pipefd_[0]=pipefd_[1]=-1;
+                splice_=false;
+                handle_forward();
+                return;
+            }
+            perror("splice error");
+            if(eventcb_) eventcb_();
+            return;
+        }
+    }
+}
+
+
+bool bfevent::drain_pipe(){
+    // peer仍有自己的待发送数据时等待其写完，保证顺序
+    if(fwdpeer_->has_pending()) return pipebytes_==0;
+    while(pipebytes_>0){
+        ssize_t n=splice(pipefd_[0], nullptr, fwdpeer_->fd_, nullptr, pipebytes_,
+                         SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+        fwdpeer_->count_out(n);
+        if(n>0){
+            pipebytes_-=n;
+        }else if(n<0&&errno==EINTR){
+            continue;
+        }else{
+            if(n<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK){
+                perror("splice error");
+                if(fwdpeer_->eventcb_) fwdpeer_->eventcb_();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void bfevent::resume_forward(){
+    if(splice_){
+        if(pipebytes_>0&&!drain_pipe()) return;
+    }else if(fwdpeer_->pending_bytes()>FWD_LOW){
+        return;
+    }
+    resume_read(PAUSE_FORWARD);
+}
+
+
+/**
+ * @brief Reads everything available and invokes the read callback once.
+ *
+ * Drains the socket until `EAGAIN`, end of stream, an error or `readbudget_` bytes,
+ * then calls `readcb_` a single time with all data in the input buffer. End of stream
+ * and errors are reported through `eventcb_` only after that data was delivered. When
+ * the budget stops the drain, an edge-triggered event is re-armed so the rest is read
+ * in a later iteration and other connections on the loop are not starved.
+ */
+void bfevent::handle_read_batch(){
+    size_t got=0;
+    bool more=false,done=false;
+    while(true){
+        int errnum=0;
+        int n=inbuff_.readiov(fd_, errnum);
+        count_in(n);
+        if(n>0){
+            got+=n;
+            if(got>=readbudget_||(inhigh_>0&&inbuff_.readbytes()>=inhigh_)){
+                more=true;
+                break;
+            }
+        }else if(n==0){
+            done=true;
+            break;
+        }else{
+            if(errno==EAGAIN||errno==EWOULDBLOCK) break;
+            perror("read error");
+            done=true;
+            break;
+        }
+    }
+    if(got>0&&readcb_) readcb_(this);
+    if(done){
+        if(eventcb_) eventcb_();
+        return;
+    }
+    if(closed_) return;
+    if(inhigh_>0&&inbuff_.readbytes()>=inhigh_) pause_read(PAUSE_INPUT);
+    else if(more&&(ev_->getevents()&EPOLLET)) ev_->update_ep();
+}
+
+/**
+ * @brief Drains pending output: buffered bytes and queued file segments in order.
+ *
+ * Buffered bytes up to the mark of the next file segment are written first, then the
+ * segment itself, and so on until the socket would block. Write interest is dropped
+ * once everything has been sent.
+ */
+void bfevent::handle_write(){
+    while(has_pending()){
+        size_t wbytes=outbuff_.readbytes();
+        if(!segs_.empty()){
+            size_t before=segs_.front().mark-outpos_;
+            if(before<wbytes) wbytes=before;
+        }
+        if(wbytes>0){
+            ssize_t n=write(fd_,outbuff_.peek(),wbytes);
+            count_out(n);
+            if(n>0){
+                drain_out(n);
+                if(writecb_) writecb_();
+            }else if(n==-1){
+                if(errno==EAGAIN||errno==EWOULDBLOCK) break;
+                perror("write error");
+                if(eventcb_) eventcb_();
+                return;
+            }
+            continue;
+        }
+        outseg &seg=segs_.front();
+        int ret=send_seg(seg);
+        if(ret<0){
+            if(eventcb_) eventcb_();
+            return;
+        }
+        if(seg.len==0){
+            if(seg.autoclose) ::close(seg.fd);
+            segs_.pop_front();
+            if(writecb_) writecb_();
+        }else if(ret==0){
+            break;
+        }
+    }
+    if(fwdsrc_&&(fwdsrc_->readpause_&PAUSE_FORWARD)&&!closed_) fwdsrc_->resume_forward();
+    if(!has_pending()&&writeable()&&!(fwdsrc_&&fwdsrc_->pipebytes_>0)) ev_->disable_write();
+    check_lowwater();
+}
+
+
+void bfevent::drain_out(size_t len){
+    outbuff_.retrieve(len);
+    outpos_+=len;
+}
+
+
+/**
+ * @brief Sends as much of a file segment as the socket accepts.
+ *
+ * Uses `sendfile(2)`; if the source does not support it (`EINVAL`/`ENOSYS`), the
+ * segment is switched to `pread` + `write` for the rest of its life so `sendfile`
+ * is not retried per chunk. Bytes already read but refused by the socket
+ * (`EAGAIN`) stay in `seg.stage` and are written first on the next call.
+ *
+ * @param seg The segment to send, its offset and length are advanced in place.
+ *
+ * @return 1 if progress was made, 0 if the socket would block, -1 on error.
+ */
+int bfevent::send_seg(outseg &seg){
+    if(seg.data) return send_zc(seg);
+    bool progress=false;
+    while(seg.len>0){
+        ssize_t n;
+        if(!seg.copy){
+            n=sendfile(fd_,seg.fd,&seg.offset,seg.len);
+            if(n<0&&(errno==EINVAL||errno==ENOSYS)){
+                seg.copy=true;
+                continue;
+            }
+        }else{
+            if(seg.stage.empty()){
+                size_t chunk=seg.len<IOBUF?seg.len:IOBUF;
+                seg.stage.resize(chunk);
+                ssize_t rn=pread(seg.fd,&seg.stage[0],chunk,seg.offset);
+                if(rn<0){
+                    perror("send_file read error");
+                    seg.stage.clear();
+                    return -1;
+                }
+                seg.stage.resize(rn);
+                seg.offset+=rn;
+            }
+            // 读到文件末尾时stage为空，n为0按文件过短处理
+            n=seg.stage.empty()?0:write(fd_,seg.stage.data(),seg.stage.size());
+            if(n>0) seg.stage.erase(0,n);
+        }
+        count_out(n);
+        if(n>0){
+            seg.len-=n;
+            progress=true;
+        }else if(n==0){
+            // 文件比声明的长度短
+            fprintf(stderr,"send_file: unexpected end of file\n");
+            return -1;
+        }else{
+            if(errno==EAGAIN||errno==EWOULDBLOCK) break;
+            perror("send_file error");
+            return -1;
+        }
+    }
+    return progress?1:0;
+}
+
+
+/**
+ * @brief Sends a user memory segment with `MSG_ZEROCOPY`.
+ *
+ * Every successful send is numbered by the kernel; once the whole segment is sent
+ * its release callback waits in `zcwait_` for the completion of the last number.
+ * If the socket runs out of option memory for pinned pages (`ENOBUFS`) the chunk
+ * is sent by copy instead.
+ *
+ * @param seg The segment to send, its offset and length are advanced in place.
+ *
+ * @return 1 if progress was made, 0 if the socket would block, -1 on error.
+ */
+int bfevent::send_zc(outseg &seg){
+    bool progress=false;
+    while(seg.len>0){
+        const char *p=seg.data+seg.offset;
+        ssize_t n=send(fd_,p,seg.len,MSG_ZEROCOPY|MSG_NOSIGNAL);
+        if(n>=0){
+            ++zcseq_;
+        }else if(errno==ENOBUFS){
+            n=send(fd_,p,seg.len,MSG_NOSIGNAL);
+        }
+        count_out(n);
+        if(n>0){
+            seg.offset+=n;
+            seg.len-=n;
+            progress=true;
+        }else if(n<0){
+            if(errno==EAGAIN||errno==EWOULDBLOCK) break;
+            perror("sendout_zc error");
+            return -1;
+        }
+    }
+    if(seg.len==0){
+        zcwait_.emplace_back(zcseq_-1, std::move(seg.release));
+        seg.release=nullptr;
+        release_zc();
+    }
+    return progress?1:0;
+}
+
+
+/**
+ * @brief Handles error-queue readiness and socket errors.
+ *
+ * With zero-copy sends outstanding, `EPOLLERR` usually only means completion
+ * notifications are queued. They are consumed here and the event callback is only
+ * invoked when the socket carries a real error.
+ */
+void bfevent::handle_event(){
+    if(zcseq_!=zcdone_&&!(ev_->getrevents()&EPOLLHUP)){
+        read_errqueue();
+        int err=0;
+        socklen_t len=sizeof(err);
+        if(getsockopt(fd_,SOL_SOCKET,SO_ERROR,&err,&len)==0&&err==0) return;
+    }
+    if(eventcb_) eventcb_();
+}
+
+
+/**
+ * @brief Reads zero-copy completion notifications off the socket error queue.
+ *
+ * Each notification covers the inclusive range [`ee_info`, `ee_data`] of send
+ * numbers. Ranges are merged into the `zcdone_` watermark, out-of-order ones are
+ * kept until the gap before them closes.
+ */
+void bfevent::read_errqueue(){
+    while(true){
+        char control[128];
+        struct msghdr msg;
+        memset(&msg,0,sizeof(msg));
+        msg.msg_control=control;
+        msg.msg_controllen=sizeof(control);
+        if(recvmsg(fd_,&msg,MSG_ERRQUEUE)==-1) break;
+        for(struct cmsghdr *cm=CMSG_FIRSTHDR(&msg);cm;cm=CMSG_NXTHDR(&msg,cm)){
+            if(!((cm->cmsg_level==SOL_IP&&cm->cmsg_type==IP_RECVERR)||
+                 (cm->cmsg_level==SOL_IPV6&&cm->cmsg_type==IPV6_RECVERR)))
+                continue;
+            struct sock_extended_err *ee=
+                reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+            if(ee->ee_errno!=0||ee->ee_origin!=SO_EE_ORIGIN_ZEROCOPY) continue;
+            if(ee->ee_code&SO_EE_CODE_ZEROCOPY_COPIED) zccopied_=true;
+            zcranges_.emplace_back(ee->ee_info, ee->ee_data);
+        }
+    }
+    bool merged=true;
+    while(merged){
+        merged=false;
+        for(size_t i=0;i<zcranges_.size();++i){
+            if(static_cast<int32_t>(zcranges_[i].first-zcdone_)<=0){
+                if(static_cast<int32_t>(zcranges_[i].second+1-zcdone_)>0)
+                    zcdone_=zcranges_[i].second+1;
+                zcranges_[i]=zcranges_.back();
+                zcranges_.pop_back();
+                merged=true;
+                break;
+            }
+        }
+    }
+    release_zc();
+}
+
+
+/**
+ * @brief Prepares the socket for close while zero-copy sends are outstanding.
+ *
+ * Completions already on the error queue are consumed first, releasing what the
+ * kernel has finished with. If some sends are still in flight, a plain close
+ * would leave their pages in the send queue while `clear_segs` hands the memory
+ * back to the caller, so `SO_LINGER` {1,0} is set to make close send an RST and
+ * purge the send queue instead. This trades the unsent tail of the stream for
+ * never transmitting memory the caller may already have reused.
+ */
+void bfevent::abort_zc(){
+    if(zcseq_==zcdone_) return;
+    read_errqueue();
+    if(zcseq_==zcdone_) return;
+    struct linger lg;
+    lg.l_onoff=1;
+    lg.l_linger=0;
+    if(setsockopt(fd_,SOL_SOCKET,SO_LINGER,&lg,sizeof(lg))==-1)
+        perror("setsockopt linger error");
+}
+
+
+void bfevent::release_zc(){
+    while(!zcwait_.empty()&&
+          static_cast<int32_t>(zcwait_.front().first-zcdone_)<0){
+        Callback cb=std::move(zcwait_.front().second);
+        zcwait_.pop_front();
+        if(cb) cb();
+    }
+}
+
+
+void bfevent::check_highwater(){
+    if(highwater_==0||abovehigh_) return;
+    size_t n=pending_bytes();
+    if(n<=highwater_) return;
+    abovehigh_=true;
+    if(pausetarget_) pausetarget_->pause_read(PAUSE_PEER);
+    if(highcb_) highcb_(this, n);
+}
+
+
+void bfevent::check_lowwater(){
+    if(!abovehigh_) return;
+    size_t n=pending_bytes();
+    if(n>lowwater_) return;
+    abovehigh_=false;
+    if(pausetarget_) pausetarget_->resume_read(PAUSE_PEER);
+    if(lowcb_) lowcb_(this, n);
+}
+
+
+void bfevent::pause_read(uint8_t why){
+    if(readpause_==0&&!closed_) ev_->disable_read();
+    readpause_|=why;
+}
+
+
+void bfevent::resume_read(uint8_t why){
+    if(readpause_==0) return;
+    readpause_&=~why;
+    if(readpause_==0&&!closed_) ev_->enable_read();
+}
+
+
+bool bfevent::has_pending() const{
+    return outbuff_.readbytes()>0||!segs_.empty();
+}
+
+
+void bfevent::clear_segs(){
+    for(auto &seg:segs_){
+        if(seg.autoclose) ::close(seg.fd);
+        if(seg.release) seg.release();
+    }
+    segs_.clear();
+    for(auto &w:zcwait_){
+        if(w.second) w.second();
+    }
+    zcwait_.clear();
+    zcranges_.clear();
+    zcdone_=zcseq_;
 }
 
 
@@ -315,3 +1180,60 @@ bfevent::Callback bfevent::getwcb() {
 bfevent::Callback bfevent::getecb() {
     return eventcb_;
 }
+
+
+/**
+ * @brief Enables or disables per-connection accounting.
+ *
+ * Counts bytes and read/write system calls, and times every event handled for this
+ * connection, user callbacks included, with the CPU timestamp counter. When the
+ * loop has `enable_topk` on, the time is also added to its ranking so the most
+ * expensive connections can be found. Disabling drops the counters.
+ *
+ * @param on Whether to account this connection.
+ */
+void bfevent::set_accounting(bool on){
+    if(on==(acct_!=nullptr)) return;
+    if(on){
+        acct_=std::make_shared<acct>();
+        ev_->setcb(std::bind(&bfevent::run_timed,this,&bfevent::handle_read),
+                  std::bind(&bfevent::run_timed,this,&bfevent::handle_write),
+                  std::bind(&bfevent::run_timed,this,&bfevent::handle_event));
+    }else{
+        if(loop_->gettopk()) loop_->gettopk()->remove(this);
+        acct_->dead=true;
+        acct_=nullptr;
+        ev_->setcb(std::bind(&bfevent::handle_read,this),
+                  std::bind(&bfevent::handle_write,this),
+                  std::bind(&bfevent::handle_event,this));
+    }
+}
+
+
+connstats bfevent::getstats() const{
+    if(!acct_) return connstats();
+    connstats st=acct_->st;
+    st.cpu_ns=cycles_to_ns(acct_->cycles);
+    return st;
+}
+
+
+/**
+ * @brief Runs an event handler and charges its duration to this connection.
+ *
+ * The handler may destroy the event (e.g. an error callback deleting it), so only
+ * locals are used afterwards and the ranking is skipped once the event is gone.
+ *
+ * @param fn The handler to run.
+ */
+void bfevent::run_timed(void (bfevent::*fn)()){
+    std::shared_ptr<acct> a=acct_;
+    eventloop *loop=loop_;
+    const void *key=this;
+    int fd=fd_;
+    uint64_t start=rdcycles();
+    (this->*fn)();
+    uint64_t used=rdcycles()-start;
+    a->cycles+=used;
+    if(!a->dead&&loop->gettopk()) loop->gettopk()->add(key,fd,used);
+}
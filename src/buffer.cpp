@@ -8,9 +8,105 @@
 //
 
 #include "buffer.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MOON_X86_SIMD 1
+#endif
 
 using namespace moon;
 
+const size_t buffer::npos;
+
+namespace {
+
+    // 查找匹配的字节序列，kernel按块比较首尾字节，候选位置再逐个memcmp确认
+    // (first/last byte filter, see http://0x80.pl/articles/simd-strfind.html)
+    inline bool match_rest(const char* p, const char* pat, size_t m) {
+        return m <= 2 || memcmp(p + 1, pat + 1, m - 2) == 0;
+    }
+
+    size_t scan_scalar(const char* p, size_t n, const char* pat, size_t m) {
+        if (m == 1) {
+            const void* r = memchr(p, pat[0], n);
+            return r ? static_cast<const char*>(r) - p : n;
+        }
+        for (size_t i = 0; i + m <= n; ++i) {
+            if (p[i] == pat[0] && p[i + m - 1] == pat[m - 1] &&
+                match_rest(p + i, pat, m))
+                return i;
+        }
+        return n;
+    }
+
+#ifdef MOON_X86_SIMD
+#ifdef __SSE2__
+    size_t scan_sse2(const char* p, size_t n, const char* pat, size_t m) {
+        const __m128i first = _mm_set1_epi8(pat[0]);
+        const __m128i last = _mm_set1_epi8(pat[m - 1]);
+        size_t i = 0;
+        for (; i + m - 1 + 16 <= n; i += 16) {
+            __m128i bf = _mm_loadu_si128((const __m128i*)(p + i));
+            __m128i bl = _mm_loadu_si128((const __m128i*)(p + i + m - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last)));
+            while (mask) {
+                unsigned bit = __builtin_ctz(mask);
+                if (match_rest(p + i + bit, pat, m)) return i + bit;
+                mask &= mask - 1;
+            }
+        }
+        size_t r = scan_scalar(p + i, n - i, pat, m);
+        return i + r;
+    }
+#endif
+
+    __attribute__((target("avx2"))) size_t scan_avx2(const char* p, size_t n,
+                                                     const char* pat,
+                                                     size_t m) {
+        const __m256i first = _mm256_set1_epi8(pat[0]);
+        const __m256i last = _mm256_set1_epi8(pat[m - 1]);
+        size_t i = 0;
+        for (; i + m - 1 + 32 <= n; i += 32) {
+            __m256i bf = _mm256_loadu_si256((const __m256i*)(p + i));
+            __m256i bl = _mm256_loadu_si256((const __m256i*)(p + i + m - 1));
+            unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last)));
+            while (mask) {
+                unsigned bit = __builtin_ctz(mask);
+                if (match_rest(p + i + bit, pat, m)) return i + bit;
+                mask &= mask - 1;
+            }
+        }
+        size_t r = scan_scalar(p + i, n - i, pat, m);
+        return i + r;
+    }
+#endif
+
+    typedef size_t (*scan_fn)(const char*, size_t, const char*, size_t);
+
+    scan_fn select_scan() {
+#ifdef MOON_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return scan_avx2;
+#ifdef __SSE2__
+        return scan_sse2;
+#endif
+#endif
+        return scan_scalar;
+    }
+
+    // 返回首个匹配位置，未找到返回n；单字节交给libc已向量化的memchr
+    size_t scan(const char* p, size_t n, const char* pat, size_t m) {
+        static const scan_fn fn = select_scan();
+        if (m == 0 || n < m) return n;
+        if (m == 1) return scan_scalar(p, n, pat, m);
+        return fn(p, n, pat, m);
+    }
+
+}  // namespace
+
 /**
  * @brief Appends data to the buffer.
  *
@@ -28,6 +124,44 @@ void buffer::append(const char* data, size_t len) {
     writer_ += len;
 }
 
+/**
+ * @brief Prepends data in front of the readable bytes.
+ *
+ * Uses the space before the read position when there is enough of it (see
+ * `headroom`), otherwise moves the readable data back to make room. Used to put
+ * frame headers in front of a payload that is already in the buffer.
+ *
+ * @param data Pointer to the data to be prepended.
+ * @param len The number of bytes to prepend.
+ */
+void buffer::prepend(const char* data, size_t len) {
+    if (reader_ < len) {
+        size_t rbytes = readbytes();
+        if (buffer_.size() < len + rbytes) buffer_.resize(len + rbytes);
+        memmove(buffer_.data() + len, buffer_.data() + reader_, rbytes);
+        reader_ = len;
+        writer_ = len + rbytes;
+    }
+    reader_ -= len;
+    memcpy(buffer_.data() + reader_, data, len);
+    scanned_ = 0;
+}
+
+/**
+ * @brief Reserves space in front of an empty buffer for later `prepend` calls.
+ *
+ * Does nothing if the buffer holds readable data.
+ *
+ * @param len The number of bytes to reserve.
+ */
+void buffer::headroom(size_t len) {
+    if (readbytes() > 0) return;
+    if (buffer_.size() < len) buffer_.resize(len);
+    reader_ = writer_ = len;
+}
+
+size_t buffer::prependable() const { return reader_; }
+
 /**
  * @brief Removes data from the buffer and copies it into a provided buffer.
  *
@@ -44,8 +178,7 @@ void buffer::append(const char* data, size_t len) {
 size_t buffer::remove(char* data, size_t len) {
     size_t rbytes = std::min(len, readbytes());
     memcpy(data, buffer_.data() + reader_, rbytes);
-    reader_ += rbytes;
-    if (reader_ == writer_) reset();
+    advance(rbytes);
     return rbytes;
 }
 
@@ -64,8 +197,7 @@ size_t buffer::remove(char* data, size_t len) {
 std::string buffer::remove(size_t len) {
     size_t rbytes = std::min(len, readbytes());
     std::string data(buffer_.data() + reader_, rbytes);
-    reader_ += rbytes;
-    if (reader_ == writer_) reset();
+    advance(rbytes);
     return data;
 }
 
@@ -91,8 +223,7 @@ std::string buffer::remove() { return remove(readbytes()); }
  */
 void buffer::retrieve(size_t len) {
     size_t rbytes = std::min(len, readbytes());
-    reader_ += rbytes;
-    if (reader_ == writer_) reset();
+    advance(rbytes);
 }
 
 /**
@@ -126,7 +257,83 @@ size_t buffer::writebytes() const { return buffer_.size() - writer_; }
  */
 const char* buffer::peek() const { return buffer_.data() + reader_; }
 
-void buffer::reset() { reader_ = writer_ = 0; }
+void buffer::reset() {
+    reader_ = writer_ = 0;
+    scanned_ = 0;
+}
+
+/**
+ * @brief Exchanges the contents of two buffers.
+ *
+ * Swaps the underlying storage and positions in constant time, so readable data
+ * can be handed to another buffer without copying it.
+ *
+ * @param other The buffer to swap with.
+ */
+void buffer::swap(buffer& other) {
+    buffer_.swap(other.buffer_);
+    std::swap(reader_, other.reader_);
+    std::swap(writer_, other.writer_);
+    std::swap(scanned_, other.scanned_);
+    scankey_.swap(other.scankey_);
+}
+
+void buffer::advance(size_t len) {
+    reader_ += len;
+    scanned_ = scanned_ > len ? scanned_ - len : 0;
+    if (reader_ == writer_) reset();
+}
+
+/**
+ * @brief Finds the first occurrence of a byte in the readable data.
+ *
+ * @param c The byte to look for.
+ *
+ * @return The offset of the byte relative to `peek()`, or `npos` if absent.
+ */
+size_t buffer::find(char c) { return find(&c, 1); }
+
+/**
+ * @brief Finds the first `\r\n` in the readable data.
+ *
+ * @return The offset of the `\r` relative to `peek()`, or `npos` if absent.
+ */
+size_t buffer::find_crlf() { return find("\r\n", 2); }
+
+/**
+ * @brief Finds the first occurrence of a byte sequence in the readable data.
+ *
+ * Multi-byte patterns are searched with SSE2/AVX2 kernels (selected at runtime)
+ * comparing the first and last pattern bytes a block at a time, with a scalar
+ * fallback elsewhere; single bytes go through `memchr`. A
+ * miss remembers how far the data was checked for this pattern, so the next
+ * search for the same pattern after more data arrives only scans the new bytes
+ * (plus `len - 1` bytes of overlap). Consuming data keeps the remembered offset
+ * valid.
+ *
+ * @param pat Pointer to the pattern.
+ * @param len The length of the pattern in bytes.
+ *
+ * @return The offset of the match relative to `peek()`, or `npos` if absent.
+ */
+size_t buffer::find(const char* pat, size_t len) {
+    size_t rbytes = readbytes();
+    if (len == 0) return 0;
+    size_t start = 0;
+    if (scankey_.size() == len && memcmp(scankey_.data(), pat, len) == 0) {
+        start = std::min(scanned_, rbytes);
+    } else {
+        scankey_.assign(pat, len);
+    }
+    const char* p = peek();
+    size_t off = start + scan(p + start, rbytes - start, pat, len);
+    if (off + len <= rbytes) {
+        scanned_ = off;
+        return off;
+    }
+    scanned_ = rbytes >= len ? rbytes - len + 1 : 0;
+    return npos;
+}
 
 /**
  * @brief Reads data from a file descriptor into the buffer using `readv`.
@@ -0,0 +1,252 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "codec.h"
+#include "buffer.h"
+#include <cstdio>
+#include <stdint.h>
+
+using namespace moon;
+
+codec::codec(const FCallback& fcb) : fcb_(fcb) {}
+
+void codec::setfcb(const FCallback& fcb) { fcb_ = fcb; }
+
+bfevent::RCallback codec::reader() {
+    return std::bind(&codec::handle_read, this, std::placeholders::_1);
+}
+
+void codec::attach(bfevent* bev) { bev->setrcb(reader()); }
+
+/**
+ * @brief Splits every complete frame out of the input buffer.
+ *
+ * The frame callback is invoked once per frame with a view of the payload inside
+ * `inbuff_`, which is consumed after the callback returns, so no per-frame copy or
+ * allocation takes place. Partial frames stay buffered until more data arrives.
+ * An invalid frame (e.g. over the length limit) invokes the event's error
+ * callback, which closes connections created by `server`.
+ *
+ * @param bev Pointer to the `bfevent` whose input is decoded.
+ */
+void codec::handle_read(bfevent* bev) {
+    buffer* buf = bev->getinbuff();
+    while (buf->readbytes() > 0) {
+        size_t off = 0, len = 0;
+        ssize_t n = decode(buf, off, len);
+        if (n == 0) break;
+        if (n < 0) {
+            fprintf(stderr, "codec: invalid frame\n");
+            bfevent::Callback ecb = bev->getecb();
+            if (ecb) ecb();
+            return;
+        }
+        if (fcb_) fcb_(bev, buf->peek() + off, len);
+        buf->retrieve(n);
+    }
+    bev->update_inlimit();
+}
+
+/**
+ * @brief Encodes the payload in `buf` as one frame, in place.
+ *
+ * The header is prepended into the buffer's headroom (reserve `headlen()` bytes
+ * with `buffer::headroom` before appending the payload to avoid a move) and the
+ * trailer is appended.
+ *
+ * @param buf The buffer holding exactly the payload.
+ * @return false if the payload cannot be framed (e.g. over the length limit).
+ */
+bool codec::encode(buffer* buf) const {
+    char head[16];
+    size_t hlen = 0;
+    iovec tail = {nullptr, 0};
+    if (!frame(buf->readbytes(), head, hlen, tail)) return false;
+    if (hlen) buf->prepend(head, hlen);
+    if (tail.iov_len)
+        buf->append(static_cast<const char*>(tail.iov_base), tail.iov_len);
+    return true;
+}
+
+/**
+ * @brief Encodes a payload as one frame and sends it.
+ *
+ * The header is built on the stack and header, payload and trailer are handed to
+ * `bfevent::sendout` as one iovec, so the payload is written straight from
+ * `data` and only copied (once, into `outbuff_`) if the socket does not take it
+ * all.
+ *
+ * @param bev Pointer to the `bfevent` to send on.
+ * @param data Pointer to the payload.
+ * @param len The length of the payload in bytes.
+ * @return false if the payload cannot be framed; nothing is sent then.
+ */
+bool codec::send(bfevent* bev, const char* data, size_t len) {
+    char head[16];
+    size_t hlen = 0;
+    iovec iov[3];
+    iov[2].iov_base = nullptr;
+    iov[2].iov_len = 0;
+    if (!frame(len, head, hlen, iov[2])) return false;
+    iov[0].iov_base = head;
+    iov[0].iov_len = hlen;
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = len;
+    bev->sendout(iov, 3);
+    return true;
+}
+
+/**
+ * @brief Constructs a length-prefixed codec.
+ *
+ * @param fcb The callback invoked for each decoded frame.
+ * @param width The length field size: 1, 2, 4 or 8 bytes, or `VARINT` for a
+ * base-128 varint (protobuf style).
+ * @param bigendian Whether fixed-width length fields are big-endian.
+ * @param maxlen The largest accepted payload length.
+ */
+lencodec::lencodec(const FCallback& fcb, int width, bool bigendian,
+                   size_t maxlen)
+    : codec(fcb), width_(width), bigendian_(bigendian), maxlen_(maxlen) {
+    if (width_ != VARINT && width_ != 1 && width_ != 2 && width_ != 4 &&
+        width_ != 8) {
+        fprintf(stderr, "lencodec: invalid width %d, using 4\n", width);
+        width_ = 4;
+    }
+}
+
+bool lencodec::frame(size_t size, char* head, size_t& hlen,
+                     iovec& tail) const {
+    uint64_t len = size;
+    if (len > maxlen_) return false;
+    size_t n = 0;
+    if (width_ == VARINT) {
+        do {
+            uint8_t b = len & 0x7f;
+            len >>= 7;
+            if (len) b |= 0x80;
+            head[n++] = static_cast<char>(b);
+        } while (len);
+    } else {
+        if (width_ < 8 && (len >> (width_ * 8)) != 0) return false;
+        for (int i = 0; i < width_; ++i) {
+            int shift = bigendian_ ? (width_ - 1 - i) * 8 : i * 8;
+            head[i] = static_cast<char>((len >> shift) & 0xff);
+        }
+        n = width_;
+    }
+    hlen = n;
+    return true;
+}
+
+ssize_t lencodec::decode(buffer* buf, size_t& off, size_t& len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf->peek());
+    size_t rbytes = buf->readbytes();
+    uint64_t value = 0;
+    size_t hlen = 0;
+    if (width_ == VARINT) {
+        int shift = 0;
+        while (true) {
+            if (hlen >= 10) return -1;
+            if (hlen >= rbytes) return 0;
+            uint8_t b = p[hlen++];
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+    } else {
+        hlen = width_;
+        if (rbytes < hlen) return 0;
+        for (int i = 0; i < width_; ++i) {
+            if (bigendian_)
+                value = (value << 8) | p[i];
+            else
+                value |= static_cast<uint64_t>(p[i]) << (i * 8);
+        }
+    }
+    if (value > maxlen_) return -1;
+    if (rbytes - hlen < value) return 0;
+    off = hlen;
+    len = value;
+    return hlen + value;
+}
+
+/**
+ * @brief Constructs a delimiter-based codec.
+ *
+ * Frames are searched with `buffer::find`, which remembers how far a partial
+ * frame was scanned, so data arriving in small pieces is not rescanned.
+ *
+ * @param fcb The callback invoked for each decoded frame.
+ * @param delim The delimiter terminating each frame, not part of the payload.
+ * @param maxlen The largest accepted payload length.
+ */
+delimcodec::delimcodec(const FCallback& fcb, const std::string& delim,
+                       size_t maxlen)
+    : codec(fcb), delim_(delim), maxlen_(maxlen) {}
+
+bool delimcodec::frame(size_t len, char* head, size_t& hlen,
+                       iovec& tail) const {
+    if (len > maxlen_) return false;
+    hlen = 0;
+    tail.iov_base = const_cast<char*>(delim_.data());
+    tail.iov_len = delim_.size();
+    return true;
+}
+
+ssize_t delimcodec::decode(buffer* buf, size_t& off, size_t& len) {
+    size_t pos = buf->find(delim_.data(), delim_.size());
+    if (pos == buffer::npos) {
+        return buf->readbytes() > maxlen_ + delim_.size() ? -1 : 0;
+    }
+    if (pos > maxlen_) return -1;
+    off = 0;
+    len = pos;
+    return pos + delim_.size();
+}
+
+fixcodec::fixcodec(const FCallback& fcb, size_t size)
+    : codec(fcb), size_(size) {}
+
+bool fixcodec::frame(size_t len, char* head, size_t& hlen,
+                     iovec& tail) const {
+    hlen = 0;
+    return len == size_;
+}
+
+ssize_t fixcodec::decode(buffer* buf, size_t& off, size_t& len) {
+    if (size_ == 0 || buf->readbytes() < size_) return 0;
+    off = 0;
+    len = size_;
+    return size_;
+}
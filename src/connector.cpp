@@ -0,0 +1,202 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "connector.h"
+#include "bfevent.h"
+#include "event.h"
+#include "eventloop.h"
+#include "timerevent.h"
+#include "wrap.h"
+#include <cerrno>
+#include <cstdio>
+
+using namespace moon;
+
+/**
+ * @brief Constructs a connector for the given remote address.
+ *
+ * Nothing is connected until `start()` is called. The timer used for connect
+ * timeouts and retry backoff is created on `loop` but stays disarmed.
+ *
+ * @param loop Pointer to the `eventloop` that will own the connection.
+ * @param addr The remote address to connect to.
+ */
+connector::connector(eventloop* loop, const sockaddr_in& addr)
+    : loop_(loop), addr_(addr) {
+    timer_ = new timerevent(loop_, 0, false);
+    timer_->setcb(std::bind(&connector::handle_timeout, this));
+    timer_->enable_listen();
+}
+
+/**
+ * @brief Destructs the connector, abandoning any attempt in progress.
+ */
+connector::~connector() {
+    close_sock();
+    timer_->del_listen();
+    delete timer_;
+}
+
+void connector::setcb(const CCallback& ccb, const FCallback& fcb) {
+    connectcb_ = ccb;
+    failcb_ = fcb;
+}
+
+void connector::set_timeout(int timeout_ms) { timeout_ms_ = timeout_ms; }
+
+void connector::set_retry(int maxretry, int init_ms, int max_ms) {
+    maxretry_ = maxretry;
+    init_ms_ = init_ms > 0 ? init_ms : 1;
+    max_ms_ = max_ms > init_ms_ ? max_ms : init_ms_;
+}
+
+bool connector::connecting() const { return state_ != IDLE; }
+
+eventloop* connector::getloop() const { return loop_; }
+
+const sockaddr_in& connector::getaddr() const { return addr_; }
+
+/**
+ * @brief Starts connecting.
+ *
+ * Issues a non-blocking `connect` and waits for completion on the loop. On success
+ * the connect callback receives a new `bfevent` on this connector's loop, owned by
+ * the caller. The connector can be started again afterwards.
+ */
+void connector::start() {
+    if (state_ != IDLE) return;
+    attempt_ = 0;
+    backoff_ms_ = init_ms_;
+    connect_once();
+}
+
+/**
+ * @brief Cancels the current attempt or pending retry without calling back.
+ */
+void connector::stop() {
+    close_sock();
+    timer_->reset(0);
+    state_ = IDLE;
+}
+
+void connector::connect_once() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        perror("connector socket");
+        retry(errno);
+        return;
+    }
+    setnonblock(fd_);
+    int ret = ::connect(fd_, (struct sockaddr*)&addr_, sizeof(addr_));
+    if (ret < 0 && errno != EINPROGRESS) {
+        retry(errno);
+        return;
+    }
+    state_ = CONNECTING;
+    // 连接完成时socket可写，失败时触发EPOLLERR
+    ev_ = new event(loop_, fd_, EPOLLOUT);
+    ev_->setcb(nullptr, std::bind(&connector::handle_connect, this),
+               std::bind(&connector::handle_connect, this));
+    ev_->enable_listen();
+    if (timeout_ms_ > 0) timer_->reset(timeout_ms_);
+}
+
+/**
+ * @brief Completes a pending connect once the socket reports writable or an error.
+ *
+ * Reads `SO_ERROR` to tell success from failure. On success the socket is handed to
+ * a new edge-triggered `bfevent` and the connect callback is invoked; otherwise
+ * the attempt is retried after the current backoff.
+ */
+void connector::handle_connect() {
+    if (state_ != CONNECTING || fd_ < 0) return;
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+    if (err != 0) {
+        retry(err);
+        return;
+    }
+    timer_->reset(0);
+    int fd = fd_;
+    // 当前处于ev_的回调中，延迟到本轮迭代结束再释放
+    ev_->del_listen();
+    ev_->disable_cb();
+    loop_->add_pending_del(ev_);
+    ev_ = nullptr;
+    fd_ = -1;
+    state_ = IDLE;
+    settcpnodelay(fd);
+    bfevent* bev = new bfevent(loop_, fd, EPOLLIN | EPOLLET);
+    if (connectcb_) connectcb_(bev);
+}
+
+void connector::handle_timeout() {
+    if (state_ == CONNECTING) {
+        retry(ETIMEDOUT);
+    } else if (state_ == BACKOFF) {
+        connect_once();
+    }
+}
+
+/**
+ * @brief Schedules the next attempt with exponential backoff, or gives up.
+ *
+ * @param err The error of the failed attempt, passed to the failure callback.
+ */
+void connector::retry(int err) {
+    close_sock();
+    if (attempt_ >= maxretry_) {
+        timer_->reset(0);
+        state_ = IDLE;
+        if (failcb_) failcb_(err);
+        return;
+    }
+    ++attempt_;
+    state_ = BACKOFF;
+    timer_->reset(backoff_ms_);
+    backoff_ms_ = backoff_ms_ * 2 > max_ms_ ? max_ms_ : backoff_ms_ * 2;
+}
+
+void connector::close_sock() {
+    if (ev_) {
+        ev_->del_listen();
+        ev_->disable_cb();
+        loop_->add_pending_del(ev_);
+        ev_ = nullptr;
+    }
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
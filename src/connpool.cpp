@@ -0,0 +1,155 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "connpool.h"
+#include "bfevent.h"
+#include "connector.h"
+#include "eventloop.h"
+#include <algorithm>
+
+using namespace moon;
+
+/**
+ * @brief Constructs a keep-alive pool for one upstream address on one loop.
+ *
+ * All methods must be called from `loop`'s thread, which lets the pool work without
+ * locks. Create one pool per loop to share upstream connections between the
+ * connections served by that loop.
+ *
+ * @param loop Pointer to the owning `eventloop`.
+ * @param addr The upstream address.
+ * @param maxidle The maximum number of idle connections kept open.
+ */
+connpool::connpool(eventloop* loop, const sockaddr_in& addr, size_t maxidle)
+    : loop_(loop), addr_(addr), maxidle_(maxidle) {}
+
+/**
+ * @brief Destructs the pool, closing idle connections and pending connects.
+ *
+ * Connections handed out by `get` belong to the caller and are not affected.
+ */
+connpool::~connpool() {
+    for (auto bev : idle_) {
+        bev->disable_cb();
+        delete bev;
+    }
+    for (auto conn : all_) delete conn;
+}
+
+void connpool::set_timeout(int timeout_ms) { timeout_ms_ = timeout_ms; }
+
+void connpool::set_retry(int maxretry, int init_ms, int max_ms) {
+    maxretry_ = maxretry;
+    init_ms_ = init_ms;
+    max_ms_ = max_ms;
+}
+
+size_t connpool::idle() const { return idle_.size(); }
+
+size_t connpool::pending() const { return pending_; }
+
+eventloop* connpool::getloop() const { return loop_; }
+
+/**
+ * @brief Obtains a connection to the upstream.
+ *
+ * The most recently returned idle connection is reused when available and passed
+ * to `cb` right away, with its callbacks cleared. Otherwise a new connection is
+ * started and `cb` runs when it completes, or with `nullptr` once connecting fails.
+ *
+ * @param cb The callback receiving the connection.
+ */
+void connpool::get(const CCallback& cb) {
+    if (!idle_.empty()) {
+        bfevent* bev = idle_.back();
+        idle_.pop_back();
+        bev->setcb(nullptr, nullptr, nullptr);
+        cb(bev);
+        return;
+    }
+    connector* conn;
+    if (!free_.empty()) {
+        conn = free_.back();
+        free_.pop_back();
+    } else {
+        conn = new connector(loop_, addr_);
+        all_.emplace_back(conn);
+    }
+    conn->set_timeout(timeout_ms_);
+    conn->set_retry(maxretry_, init_ms_, max_ms_);
+    conn->setcb(
+        [this, conn, cb](bfevent* bev) { handle_connect(conn, cb, bev); },
+        [this, conn, cb](int) { handle_connect(conn, cb, nullptr); });
+    ++pending_;
+    conn->start();
+}
+
+void connpool::handle_connect(connector* conn, const CCallback& cb,
+                              bfevent* bev) {
+    --pending_;
+    // 连接器可能仍在自身回调中，只放回复用列表
+    free_.emplace_back(conn);
+    cb(bev);
+}
+
+/**
+ * @brief Returns a connection for reuse.
+ *
+ * The connection must have no unread input or unsent output, since the next user
+ * expects a clean stream. While idle, any input or a close by the upstream discards
+ * it. Beyond `maxidle` idle connections the returned one is closed. `put` replaces the
+ * connection's callbacks, so when called from one of them the caller must not touch
+ * that callback's captured state afterwards.
+ *
+ * @param bev The connection obtained from `get`.
+ */
+void connpool::put(bfevent* bev) {
+    if (idle_.size() >= maxidle_ || bev->readbytes() > 0 ||
+        bev->pending_bytes() > 0) {
+        bev->disable_cb();
+        loop_->add_pending_del(bev);
+        return;
+    }
+    // 空闲连接上出现数据或关闭都视为不可复用
+    bev->setcb([this](bfevent* b) { discard(b); }, nullptr, nullptr);
+    bev->setecb([this, bev]() { discard(bev); });
+    idle_.emplace_back(bev);
+}
+
+void connpool::discard(bfevent* bev) {
+    auto it = std::find(idle_.begin(), idle_.end(), bev);
+    if (it == idle_.end()) return;
+    idle_.erase(it);
+    bev->disable_cb();
+    loop_->add_pending_del(bev);
+}
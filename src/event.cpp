@@ -62,6 +62,8 @@ void event::setecb(const Callback &ecb) { eventcb_ = ecb; }
 
 void event::setrevents(const uint32_t revents) { revents_ = revents; }
 
+uint32_t event::getrevents() const { return revents_; }
+
 void event::update_ep() { loop_->mod_event(this); }
 
 void event::enable_events(uint32_t op) {
@@ -34,9 +34,27 @@ Author: MoonforDream
 #include "base_event.h"
 #include "eventloop.h"
 #include "event.h"
+#include "watchdog.h"
+#include <algorithm>
+#include <ctime>
 
 using namespace moon;
 
+namespace {
+    uint64_t now_us() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    }
+
+    // 心跳用粗粒度时钟，精度为一个tick，开销远低于CLOCK_MONOTONIC
+    uint64_t coarse_us() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    }
+}  // namespace
+
 /**
  * @brief Constructs a new `eventloop` instance.
  *
@@ -62,6 +80,8 @@ eventloop::eventloop(loopthread* base, int timeout)
 }
 
 eventloop::~eventloop() {
+    watchdog* dog = dog_.load();
+    if (dog) dog->unwatch(this);
     loopbreak();
     for (auto& ev : evlist_) {
         delete ev;
@@ -71,6 +91,7 @@ eventloop::~eventloop() {
     }
     evlist_.clear();
     delque_.clear();
+    delete topk_;
     close(epfd_);
     close(eventfd_);
 }
@@ -125,21 +146,49 @@ void eventloop::mod_event(event* event) {
  * @brief Starts the event loop.
  *
  * Continuously waits for events using `epoll_wait`, handles triggered events,
- * resizes the events vector if necessary, and processes pending deletions.
+ * flushes events queued with `add_pending_flush`, resizes the events vector if
+ * necessary, and processes pending deletions.
  */
 void eventloop::loop() {
+    tid_.store(pthread_self(), std::memory_order_release);
     while (!shutdown_) {
-        int n = epoll_wait(epfd_, events_.data(), MAX_EVENTS, timeout_);
+        // 仍有待刷新事件时不阻塞
+        int timeout = flushque_.empty() ? timeout_ : 0;
+        int n = epoll_wait(epfd_, events_.data(), MAX_EVENTS, timeout);
         if (-1 == n) {
             if (errno == EINTR) continue;
             perror("epoll_wait");
             break;
         }
+        uint64_t start = 0;
+        // 本轮只读一次，避免中途被其他线程开启时用start=0计算耗时
+        bool stats = stats_.load(std::memory_order_relaxed);
+        if (stats) {
+            start = now_us();
+            busysince_.store(start, std::memory_order_relaxed);
+            ready_.store(n, std::memory_order_relaxed);
+        }
+        bool watched = dog_.load(std::memory_order_relaxed) != nullptr;
         for (int i = 0; i < n; ++i) {
             auto ev = static_cast<event*>(events_[i].data.ptr);
             ev->setrevents(events_[i].events);
+            if (watched) beat(ev->getfd(), ev);
             ev->handle_cb();
         }
+        if (!flushque_.empty()) {
+            if (watched) beat(-1, nullptr);
+            do_flush();
+        }
+        if (watched) cbstart_.store(0, std::memory_order_relaxed);
+        if (stats) {
+            // 本轮后就绪的事件最多等待本轮处理耗时
+            uint64_t end = now_us();
+            uint64_t lag = lag_us_.load(std::memory_order_relaxed);
+            lag_us_.store((lag * 7 + (end - start)) / 8,
+                          std::memory_order_relaxed);
+            lastend_.store(end, std::memory_order_relaxed);
+            busysince_.store(0, std::memory_order_relaxed);
+        }
         if (n == events_.size()) {
             events_.resize(events_.size() * 2);
         }
@@ -150,6 +199,7 @@ void eventloop::loop() {
             delque_.clear();
         }
     }
+    tid_.store(0, std::memory_order_release);
 }
 
 void eventloop::loopbreak() {
@@ -212,3 +262,190 @@ void eventloop::write_eventfd() {
  * @param ev Pointer to the `base_event` to be deleted.
  */
 void eventloop::add_pending_del(base_event* ev) { delque_.emplace_back(ev); }
+
+/**
+ * @brief Queues an event whose `handle_flush` runs at the end of the current iteration.
+ *
+ * Lets events that coalesce output (e.g. corked `bfevent`s) issue one write for
+ * everything produced by the callbacks of this iteration. Must be called from the
+ * loop thread; the caller avoids queueing the same event twice.
+ *
+ * @param ev Pointer to the `base_event` to flush.
+ */
+void eventloop::add_pending_flush(base_event* ev) { flushque_.emplace_back(ev); }
+
+/**
+ * @brief Removes an event from the flush queue, e.g. before it is destroyed.
+ *
+ * @param ev Pointer to the `base_event` to remove.
+ */
+void eventloop::del_pending_flush(base_event* ev) {
+    for (auto& e : flushque_) {
+        if (e == ev) e = nullptr;
+    }
+    for (auto& e : flushing_) {
+        if (e == ev) e = nullptr;
+    }
+}
+
+/**
+ * @brief Flushes the events queued during this iteration.
+ *
+ * Events queued again while flushing (e.g. from a write callback) are left for
+ * the next iteration, which then polls without blocking.
+ */
+void eventloop::do_flush() {
+    flushing_.swap(flushque_);
+    for (size_t i = 0; i < flushing_.size(); ++i) {
+        if (flushing_[i]) flushing_[i]->handle_flush();
+    }
+    flushing_.clear();
+}
+
+/**
+ * @brief Enables or disables loop lag statistics.
+ *
+ * When enabled, every iteration records the time spent handling its ready events.
+ * Events that become ready meanwhile wait that long, so a moving average of it is
+ * used as the loop's lag. Costs two clock reads per iteration.
+ *
+ * @param on Whether to collect statistics.
+ */
+void eventloop::enable_stats(bool on) {
+    stats_.store(on, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the current lag of the loop in microseconds.
+ *
+ * This is an estimate, not a measured readiness-to-callback delay: the kernel does
+ * not report when an fd became ready, so the moving average of the iteration time
+ * stands in for the longest wait of an event that became ready during an iteration.
+ * Safe to call from any thread. A loop stuck in a long callback reports the time
+ * spent in it so far; a loop that has been idle for a while reports 0.
+ *
+ * @return The estimated lag in microseconds.
+ */
+uint64_t eventloop::getlag_us() const {
+    uint64_t lag = lag_us_.load(std::memory_order_relaxed);
+    uint64_t since = busysince_.load(std::memory_order_relaxed);
+    uint64_t now = now_us();
+    if (since != 0) return std::max(lag, now - since);
+    // 空闲超过平均耗时说明已追上
+    uint64_t end = lastend_.load(std::memory_order_relaxed);
+    return now - end > lag ? 0 : lag;
+}
+
+/**
+ * @brief Returns the number of events the last `epoll_wait` reported ready.
+ *
+ * Used as the queue depth of the loop. It is a snapshot of one iteration, not a
+ * count of events still waiting, and is only updated while statistics are enabled.
+ *
+ * @return The ready-event count of the last iteration.
+ */
+int eventloop::getready() const {
+    return ready_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets the watchdog observing this loop; called by `watchdog::watch`.
+ *
+ * While set, every callback publishes a heartbeat (sequence number, start time,
+ * fd) before it runs. Costs a coarse clock read and a few relaxed stores per
+ * callback.
+ *
+ * @param dog Pointer to the `watchdog`, or nullptr to stop publishing.
+ */
+void eventloop::setwatchdog(watchdog* dog) {
+    dog_.store(dog);
+    if (!dog) cbstart_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Publishes the heartbeat of the callback about to run.
+ */
+void eventloop::beat(int fd, event* ev) {
+    cbfd_.store(fd, std::memory_order_relaxed);
+    cbev_.store(ev, std::memory_order_relaxed);
+    cbstart_.store(coarse_us(), std::memory_order_relaxed);
+    seq_.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief Takes a snapshot of the heartbeat from any thread.
+ *
+ * The fields are read without locking; a callback that is still running has a
+ * stable snapshot, which is all the watchdog needs.
+ *
+ * @param seq Receives the sequence number of the current callback.
+ * @param fd Receives its fd, -1 while flushing queued output.
+ * @param ev Receives its event.
+ * @return Microseconds the current callback has been running, 0 if idle.
+ */
+uint64_t eventloop::getheartbeat(uint64_t& seq, int& fd, event*& ev) const {
+    seq = seq_.load(std::memory_order_acquire);
+    uint64_t start = cbstart_.load(std::memory_order_relaxed);
+    fd = cbfd_.load(std::memory_order_relaxed);
+    ev = cbev_.load(std::memory_order_relaxed);
+    if (start == 0) return 0;
+    uint64_t now = coarse_us();
+    return now > start ? now - start : 0;
+}
+
+pthread_t eventloop::getthread() const {
+    return tid_.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Enables the per-loop ranking of connections by callback time.
+ *
+ * `bfevent`s on this loop with accounting enabled add the time of each of their
+ * callbacks to a Space-Saving sketch of `k` slots. May be called from any thread;
+ * only the first call takes effect.
+ *
+ * @param k The number of connections tracked.
+ */
+void eventloop::enable_topk(size_t k) {
+    if (topk_.load()) return;
+    topk* sketch = new topk(k);
+    topk* expect = nullptr;
+    if (!topk_.compare_exchange_strong(expect, sketch)) delete sketch;
+}
+
+topk* eventloop::gettopk() const {
+    return topk_.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Returns the connections that used the most loop time. Thread-safe.
+ *
+ * Comparing the top entries with `total_ns` tells a single abusive client from
+ * evenly spread load.
+ *
+ * @param n The maximum number of entries.
+ * @param total_ns If not null, receives the time used by all accounted connections.
+ * @return Entries with `cost` and `error` in nanoseconds, highest first.
+ */
+std::vector<talker> eventloop::gettop(size_t n, uint64_t* total_ns) const {
+    std::vector<talker> res;
+    if (total_ns) *total_ns = 0;
+    topk* sketch = gettopk();
+    if (!sketch) return res;
+    res = sketch->top(n);
+    for (auto& t : res) {
+        t.cost = cycles_to_ns(t.cost);
+        t.error = cycles_to_ns(t.error);
+    }
+    if (total_ns) *total_ns = cycles_to_ns(sketch->total());
+    return res;
+}
+
+void eventloop::reset_topk() {
+    topk* sketch = gettopk();
+    if (sketch) sketch->reset();
+}
+
+void eventloop::setcpu(int cpu) { cpu_.store(cpu); }
+
+int eventloop::getcpu() const { return cpu_.load(std::memory_order_relaxed); }
@@ -33,6 +33,8 @@ Author: MoonforDream
 
 #include "lfthread.h"
 #include "ringbuff.h"
+#include "mpmcring.h"
+#include "signalevent.h"
 
 using namespace moon;
 
@@ -46,7 +48,7 @@ using namespace moon;
  * is full.
  */
 bool lfthread::enqueue_task(task _task) {
-    if (buffer_.push(_task)) {
+    if (buffer_.push_move(std::move(_task))) {
         return true;
     } else {
         // buffer_ is full
@@ -78,8 +80,7 @@ bool lfthread::enqueue_task_move(task&& _task) {
  * thread for shutdown.
  */
 void lfthread::t_shutdown() {
-    if (shutdown_) return;
-    shutdown_ = true;
+    if (shutdown_.exchange(true)) return;
     // 推送一个空任务以唤醒线程退出
     buffer_.push([]() {});
     if (t_.joinable()) t_.join();
@@ -90,6 +91,7 @@ void lfthread::t_shutdown() {
  *        Implements a dynamic backoff strategy to manage polling for tasks.
  */
 void lfthread::t_task() {
+    signalevent::block_subscribed();
     // 动态退避策略
     auto min_sleep = std::chrono::milliseconds(1);
     auto max_sleep = std::chrono::milliseconds(100);
@@ -105,8 +107,8 @@ void lfthread::t_task() {
         }
     }
     // execute task before shutdown
-    while (buffer_.pop(_task)) {
-        task();
+    while (buffer_.pop_move(_task)) {
+        _task();
     }
 }
 
@@ -118,11 +120,14 @@ void lfthread::t_task() {
 int lfthread::getload() const { return buffer_.size(); }
 
 /**
- * @brief Swaps the internal buffer with another ring buffer.
+ * @brief Moves queued tasks into another ring buffer until it is full.
  *
- * @param rb_ The ring buffer to swap with.
+ * @param rb_ The ring buffer to move tasks into.
  */
-void lfthread::swap_to_ringbuff(ringbuff<task>& rb_) { buffer_.swap(rb_); }
+void lfthread::swap_to_ringbuff(ringbuff<task>& rb_) {
+    task _task;
+    while (!rb_.full() && buffer_.pop_move(_task)) rb_.push_move(std::move(_task));
+}
 
 /**
  * @brief Swaps the internal buffer content to a std::list.
@@ -130,7 +135,8 @@ void lfthread::swap_to_ringbuff(ringbuff<task>& rb_) { buffer_.swap(rb_); }
  * @param list_ List to transfer tasks to.
  */
 void lfthread::swap_to_list(std::list<lfthread::task>& list_) {
-    buffer_.swap_to_list(list_);
+    task _task;
+    while (buffer_.pop_move(_task)) list_.emplace_back(std::move(_task));
 }
 
 /**
@@ -139,7 +145,9 @@ void lfthread::swap_to_list(std::list<lfthread::task>& list_) {
  * @param vec_ Vector to transfer tasks to.
  */
 void lfthread::swap_to_vector(std::vector<lfthread::task>& vec_) {
-    buffer_.swap_to_vector(vec_);
+    task _task;
+    vec_.reserve(vec_.size() + buffer_.size());
+    while (buffer_.pop_move(_task)) vec_.emplace_back(std::move(_task));
 }
 
 /**
@@ -149,7 +157,9 @@ void lfthread::swap_to_vector(std::vector<lfthread::task>& vec_) {
  * the buffer.
  */
 std::list<lfthread::task> lfthread::swap_to_list() {
-    return buffer_.swap_to_list();
+    std::list<task> list_;
+    swap_to_list(list_);
+    return list_;
 }
 
 /**
@@ -159,7 +169,9 @@ std::list<lfthread::task> lfthread::swap_to_list() {
  * from the buffer.
  */
 std::vector<lfthread::task> lfthread::swap_to_vector() {
-    return buffer_.swap_to_vector();
+    std::vector<task> vec_;
+    swap_to_vector(vec_);
+    return vec_;
 }
 
 /**
@@ -169,7 +181,7 @@ std::vector<lfthread::task> lfthread::swap_to_vector() {
  * from the buffer.
  */
 lfthread::lfthread(lfthread&& other) noexcept
-    : shutdown_(other.shutdown_), t_(std::move(other.t_)) {
+    : shutdown_(other.shutdown_.load()), t_(std::move(other.t_)) {
     buffer_.swap(other.buffer_);
     // other.buffer_.swap(buffer_);
 }
@@ -186,7 +198,7 @@ lfthread& lfthread::operator=(lfthread&& other) noexcept {
     if (this != &other) {
         t_shutdown();
         buffer_.swap(other.buffer_);
-        shutdown_ = other.shutdown_;
+        shutdown_ = other.shutdown_.load();
         t_ = std::move(other.t_);
     }
     return *this;
@@ -35,6 +35,7 @@ Author: MoonforDream
 #include <atomic>
 #include <chrono>
 #include "lfthread.h"
+#include "signalevent.h"
 
 using namespace moon;
 
@@ -49,7 +50,11 @@ using namespace moon;
  * @param mode Operation mode of the pool, either static or dynamic.
  */
 lfthreadpool::lfthreadpool(int tnum, size_t buffsize, PoolMode mode)
-    : shutdown_(false), mode_(mode), buffsize_(buffsize) {
+    : shutdown_(false),
+      mode_(mode),
+      buffsize_(buffsize),
+      next_(0),
+      inflight_(0) {
     // 默认为-1,表示使用内置计算适合线程数
     if (tnum <= 0)
         setnum();
@@ -96,17 +101,45 @@ const size_t lfthreadpool::getnext() {
     if (mode_ == PoolMode::Dynamic) {
         idx = getminidx();
     } else if (mode_ == PoolMode::Static) {
-        next_ = (next_ + 1) % tnum_;
-        idx = next_;
+        // 票号原子递增，多个生产者同时提交也不会重复或越界
+        idx = next_.fetch_add(1, std::memory_order_relaxed) %
+              tnum_.load(std::memory_order_acquire);
     }
     return idx;
 }
 
+/**
+ * @brief Registers an in-flight submission, failing if the pool is shutting
+ * down.
+ *
+ * Pairs with t_shutdown(): either the submitter sees the shutdown flag and
+ * backs off, or t_shutdown sees the in-flight count and waits for the task to
+ * reach a worker's queue before stopping the workers, so an accepted task is
+ * never left behind in a drained queue.
+ *
+ * @return bool False if the pool is shutting down.
+ */
+bool lfthreadpool::enter() {
+    inflight_.fetch_add(1, std::memory_order_seq_cst);
+    if (shutdown_.load(std::memory_order_seq_cst)) {
+        leave();
+        return false;
+    }
+    return true;
+}
+
+void lfthreadpool::leave() {
+    inflight_.fetch_sub(1, std::memory_order_release);
+}
+
 /**
  * @brief Shuts down the thread pool and joins all threads to ensure clean exit.
  */
 void lfthreadpool::t_shutdown() {
-    if (shutdown_.exchange(true, std::memory_order_acquire)) return;
+    if (shutdown_.exchange(true, std::memory_order_seq_cst)) return;
+    // 等待已通过检查的提交者把任务放入队列
+    while (inflight_.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
     if (mode_ == PoolMode::Dynamic && mentor_.joinable()) mentor_.join();
     for (int i = 0; i < tnum_; ++i) {
         workers_[i]->t_shutdown();
@@ -147,6 +180,7 @@ void lfthreadpool::add_thread() {
  * load.
  */
 void lfthreadpool::adjust_task() {
+    signalevent::block_subscribed();
     while (shutdown_) {
         std::this_thread::sleep_for(std::chrono::seconds(timesec_));
         if (shutdown_) break;
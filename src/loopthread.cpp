@@ -9,6 +9,10 @@
 
 #include "loopthread.h"
 #include "eventloop.h"
+#include "signalevent.h"
+#include <cstdio>
+#include <pthread.h>
+#include <sched.h>
 
 using namespace moon;
 
@@ -23,6 +27,8 @@ loopthread::~loopthread() {
 }
 
 void loopthread::_init_() {
+    // 信号统一由signalfd接收，避免被投递到loop线程执行默认动作
+    signalevent::block_subscribed();
     eventloop *loop = new eventloop(this, timeout_);
     {
         std::unique_lock<std::mutex> lock(mx_);
@@ -41,3 +47,23 @@ eventloop *loopthread::getloop() {
     }
     return ep;
 }
+
+/**
+ * @brief Pins the loop thread to one CPU and records it on the loop.
+ *
+ * @param cpu The CPU number.
+ * @return Whether the affinity was applied.
+ */
+bool loopthread::setaffinity(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(t_.native_handle(), sizeof(set), &set);
+    if (ret != 0) {
+        errno = ret;
+        perror("pthread_setaffinity_np");
+        return false;
+    }
+    getloop()->setcpu(cpu);
+    return true;
+}
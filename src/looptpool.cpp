@@ -34,6 +34,8 @@ Author: MoonforDream
 #include "looptpool.h"
 #include "eventloop.h"
 #include "loopthread.h"
+#include "signalevent.h"
+#include <sched.h>
 
 using namespace moon;
 
@@ -135,6 +137,54 @@ eventloop* looptpool::ev_dispatch() {
     }
 }
 
+/**
+ * @brief Dispatches to the loop pinned to `cpu`.
+ *
+ * Used with the CPU a connection arrived on (`SO_INCOMING_CPU`) so that the
+ * kernel's packet processing and the loop's callbacks share that CPU's caches.
+ * Falls back to `ev_dispatch()` when no loop is pinned to `cpu`.
+ *
+ * @param cpu The CPU number, -1 if unknown.
+ * @return Pointer to the selected `eventloop` instance.
+ */
+eventloop* looptpool::ev_dispatch(int cpu) {
+    if (cpu >= 0) {
+        for (int i = 0; i < t_num; ++i) {
+            if (loadvec_[i]->getcpu() == cpu) return loadvec_[i];
+        }
+    }
+    return ev_dispatch();
+}
+
+/**
+ * @brief Pins each loop thread to one CPU.
+ *
+ * Loop `i` is pinned to `cpus[i % cpus.size()]`. Loops added later by the dynamic
+ * adjustment are not pinned, so this is meant for `create_pool_noadjust` pools.
+ *
+ * @param cpus The CPUs to use; empty for the CPUs the process may run on.
+ * @return The CPU of each loop, -1 where pinning failed.
+ */
+std::vector<int> looptpool::pin_loops(const std::vector<int>& cpus) {
+    std::vector<int> avail = cpus;
+    if (avail.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; ++c) {
+                if (CPU_ISSET(c, &set)) avail.push_back(c);
+            }
+        }
+    }
+    std::vector<int> res;
+    if (avail.empty()) return res;
+    for (int i = 0; i < t_num; ++i) {
+        int cpu = avail[i % avail.size()];
+        res.push_back(loadvec_[i]->getbaseloop()->setaffinity(cpu) ? cpu : -1);
+    }
+    return res;
+}
+
 /**
  * @brief Deletes the event loop with the maximum load and redistributes its
  * events.
@@ -169,6 +219,15 @@ void looptpool::addloop() {
     ++t_num;
 }
 
+/**
+ * @brief Returns the event loops of all sub-reactors.
+ *
+ * @return A copy of the loop list; empty when the pool has not been created.
+ */
+std::vector<eventloop*> looptpool::getloops() const {
+    return loadvec_;
+}
+
 /**
  * @brief Calculates the average load scale of all event loops.
  *
@@ -197,6 +256,7 @@ int looptpool::getscale() {
  * enabled.
  */
 void looptpool::adjust_task() {
+    signalevent::block_subscribed();
     while (dispath_) {
         std::this_thread::sleep_for(std::chrono::seconds(timesec_));
         if (!dispath_) break;
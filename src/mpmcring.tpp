@@ -0,0 +1,203 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#ifndef _MPMCRING_TPP_
+#define _MPMCRING_TPP_
+
+namespace moon {
+
+    /**
+     * @brief Constructs the queue; the capacity is rounded up to a power of
+     * two (at least 2). Slot i starts with sequence i, meaning "free for the
+     * producer holding ticket i".
+     *
+     * @param size Requested capacity.
+     */
+    template <class T>
+    mpmcring<T>::mpmcring(size_t size)
+        : mask_(adj_size(size) - 1),
+          buffer_(new cell[mask_ + 1]),
+          enq_(0),
+          deq_(0) {
+        for (size_t i = 0; i <= mask_; ++i)
+            buffer_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    template <class T>
+    mpmcring<T>::~mpmcring() {
+        delete[] buffer_;
+    }
+
+    /**
+     * @brief Claims the next producer ticket and stores the item in its slot.
+     *
+     * A slot whose sequence equals the ticket is free; a smaller sequence
+     * means the consumer has not released it yet, i.e. the queue is full.
+     * The release store of ticket + 1 publishes the item to consumers.
+     *
+     * @param item The item to copy or move in.
+     * @return `false` if the queue is full.
+     */
+    template <class T>
+    template <class U>
+    bool mpmcring<T>::enqueue(U&& item) {
+        size_t pos = enq_.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;) {
+            c = &buffer_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (enq_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = enq_.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = std::forward<U>(item);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Pushes a copy of the item. Safe from any number of threads.
+     *
+     * @param item The item to push.
+     * @return `true` on success, `false` if the queue is full.
+     */
+    template <class T>
+    bool mpmcring<T>::push(const T& item) {
+        return enqueue(item);
+    }
+
+    /**
+     * @brief Pushes the item by move. Safe from any number of threads.
+     *
+     * @param item The item to push.
+     * @return `true` on success, `false` if the queue is full.
+     */
+    template <class T>
+    bool mpmcring<T>::push_move(T&& item) {
+        return enqueue(std::move(item));
+    }
+
+    /**
+     * @brief Pops the oldest item, moving it out. Safe from any number of
+     * threads.
+     *
+     * The slot is handed back to producers of the next lap by storing
+     * ticket + capacity as its sequence.
+     *
+     * @param item Receives the popped item.
+     * @return `true` on success, `false` if the queue is empty.
+     */
+    template <class T>
+    bool mpmcring<T>::pop_move(T& item) {
+        size_t pos = deq_.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;) {
+            c = &buffer_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (deq_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = deq_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(c->data);
+        c->data = T();  // 释放任务捕获的资源，不要等到槽位被覆盖
+        c->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Same as pop_move; the slot is always vacated, so copying would
+     * gain nothing.
+     */
+    template <class T>
+    bool mpmcring<T>::pop(T& item) {
+        return pop_move(item);
+    }
+
+    template <class T>
+    size_t mpmcring<T>::capacity() const {
+        return mask_ + 1;
+    }
+
+    template <class T>
+    size_t mpmcring<T>::size() const {
+        size_t deq = deq_.load(std::memory_order_acquire);
+        size_t enq = enq_.load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    template <class T>
+    bool mpmcring<T>::empty() const {
+        return size() == 0;
+    }
+
+    template <class T>
+    bool mpmcring<T>::full() const {
+        return size() >= capacity();
+    }
+
+    template <class T>
+    void mpmcring<T>::swap(mpmcring& other) noexcept {
+        std::swap(mask_, other.mask_);
+        std::swap(buffer_, other.buffer_);
+        enq_.store(other.enq_.exchange(enq_.load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+        deq_.store(other.deq_.exchange(deq_.load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    }
+
+    template <class T>
+    size_t mpmcring<T>::adj_size(size_t size) {
+        size_t n = 2;
+        while (n < size) n <<= 1;
+        return n;
+    }
+
+}  // namespace moon
+
+#endif  // !_MPMCRING_TPP_
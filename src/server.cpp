@@ -36,6 +36,7 @@ Author: MoonforDream
 #include "udpevent.h"
 #include "signalevent.h"
 #include "timerevent.h"
+#include <algorithm>
 
 using namespace moon;
 
@@ -52,6 +53,11 @@ server::server(int port) : pool_(&base_),acceptor_(port, &base_),port_(port){
 
 server::~server() {
     stop();
+    delete dog_;
+    if (overtimer_) {
+        overtimer_->del_listen();
+        delete overtimer_;
+    }
     if (tcp_enable_) acceptor_.stop();
     std::lock_guard<std::mutex> lock(events_mutex_);
     for (auto &ev : events_) {
@@ -89,11 +95,12 @@ eventloop *server::getloop() { return &base_; }
  * without performing any actions.
  *
  * @param port The port number on which to enable TCP listening.
+ * @param opts Socket options for the listener and accepted connections.
  */
-void server::enable_tcp(int port) {
+void server::enable_tcp(int port, const sockopts &opts) {
     if (tcp_enable_) return;
     port_ = port;
-    acceptor_.init_sock(port);
+    acceptor_.init_sock(port, opts);
     acceptor_.setcb(std::bind(&server::acceptcb_, this, std::placeholders::_1));
     acceptor_.listen();
     tcp_enable_ = true;
@@ -101,6 +108,128 @@ void server::enable_tcp(int port) {
 
 void server::enable_tcp_accept() { acceptor_.listen(); }
 
+/**
+ * @brief Enables admission control for new TCP connections.
+ *
+ * Turns on lag statistics for every sub-reactor and checks them before each
+ * accept. The server is overloaded once the worst loop lag exceeds `high_us` (or a
+ * loop had more than `maxready` ready events in its last iteration) and recovers
+ * when the lag falls below `low_us`, so the decision does not flap. While
+ * overloaded, connections are reset right after accept when `reject` is set;
+ * otherwise the acceptor stops and a timer on the main loop, armed only while the
+ * acceptor is paused, checks every 10 ms and resumes it once the load has dropped.
+ * `high_us` of 0 disables the check.
+ *
+ * @param high_us The lag in microseconds at which new connections are shed.
+ * @param low_us The lag in microseconds below which connections are admitted again.
+ * @param reject Whether to reset connections rather than pausing the acceptor.
+ * @param maxready The ready-event count per iteration treated as overload; 0 ignores it.
+ */
+void server::set_overload(int high_us, int low_us, bool reject, int maxready) {
+    overhigh_us_ = high_us;
+    overlow_us_ = low_us < high_us ? low_us : high_us;
+    maxready_ = maxready;
+    overloaded_ = false;
+    // 重新配置时恢复因过载暂停的接受
+    if (overtimer_) overtimer_->reset(0);
+    if (tcp_enable_ && !acceptor_.listening()) acceptor_.listen();
+    std::vector<eventloop *> loops = pool_.getloops();
+    if (loops.empty()) loops.push_back(&base_);
+    for (auto loop : loops) loop->enable_stats(high_us > 0);
+    if (high_us <= 0) {
+        acceptor_.setadmit(nullptr, reject);
+        return;
+    }
+    if (!reject && !overtimer_) {
+        // 超时为0时不触发，仅在暂停接受时启动
+        overtimer_ = new timerevent(&base_, 0, true);
+        overtimer_->setcb([this]() {
+            if (!tcp_enable_ || acceptor_.listening()) {
+                overtimer_->reset(0);
+            } else if (!overloaded()) {
+                acceptor_.listen();
+                overtimer_->reset(0);
+            }
+        });
+        overtimer_->enable_listen();
+    }
+    acceptor_.setadmit([this, reject]() {
+        if (!overloaded()) return true;
+        // 拒绝为false时acceptor随即暂停，由定时器检查恢复
+        if (!reject) overtimer_->reset(10);
+        return false;
+    }, reject);
+}
+
+bool server::overloaded() {
+    if (overhigh_us_ <= 0) return false;
+    std::vector<eventloop *> loops = pool_.getloops();
+    if (loops.empty()) loops.push_back(&base_);
+    uint64_t lag = 0;
+    int ready = 0;
+    for (auto loop : loops) {
+        lag = std::max(lag, loop->getlag_us());
+        ready = std::max(ready, loop->getready());
+    }
+    bool deep = maxready_ > 0 && ready > maxready_;
+    if (overloaded_) {
+        if (lag < (uint64_t)overlow_us_ && !deep) overloaded_ = false;
+    } else if (lag > (uint64_t)overhigh_us_ || deep) {
+        overloaded_ = true;
+    }
+    return overloaded_;
+}
+
+/**
+ * @brief Starts a watchdog over the main loop and the current sub-loops.
+ *
+ * Call after `init_pool`. Stall records go to `cb` on the watchdog thread, or
+ * to stderr when `cb` is empty. Calling it again replaces the watchdog.
+ *
+ * @param threshold_ms Callbacks running longer than this are reported.
+ * @param cb Sink for stall records.
+ */
+void server::enable_watchdog(int threshold_ms, const watchdog::WCallback &cb) {
+    delete dog_;
+    dog_ = new watchdog(threshold_ms, cb);
+    dog_->watch(&base_);
+    for (auto loop : pool_.getloops()) dog_->watch(loop);
+    dog_->start();
+}
+
+/**
+ * @brief Enables accounting for connections accepted from now on.
+ *
+ * Every sub-loop (or the main loop without a pool) ranks its connections by the
+ * time spent handling them; query it with `eventloop::gettop`.
+ *
+ * @param k The number of connections each loop's ranking tracks.
+ */
+void server::enable_accounting(size_t k) {
+    std::vector<eventloop *> loops = pool_.getloops();
+    if (loops.empty()) loops.push_back(&base_);
+    for (auto loop : loops) loop->enable_topk(k);
+    accounting_ = true;
+}
+
+/**
+ * @brief Places connections on the loop pinned to the CPU they arrived on.
+ *
+ * Pins every sub-loop to a CPU, then dispatches each accepted connection by its
+ * `SO_INCOMING_CPU`, so the softirq processing of a flow and its callbacks share
+ * caches. Connections from CPUs without a loop use the normal dispatch. UDP shards
+ * added afterwards get a reuseport CBPF program doing the same per datagram.
+ * Works best when NIC queues (RSS/RPS) are spread over the same CPUs.
+ *
+ * @param cpus The CPUs to pin to; empty for the CPUs the process may run on.
+ */
+void server::set_cpu_dispatch(const std::vector<int> &cpus) {
+    loopcpus_ = pool_.pin_loops(cpus);
+    cpudispatch_ = !loopcpus_.empty();
+}
+
+size_t server::getrejected() const { return acceptor_.getrejected(); }
+
 void server::disable_tcp_accept() { acceptor_.stop(); }
 
 /**
@@ -184,7 +313,7 @@ void server::delev(base_event *ev) {
 udpevent *server::add_udpev(int port, const UCallback &rcb,
                             const Callback &ecb) {
     udpevent *uev = new udpevent(pool_.ev_dispatch(), port);
-    uev->setcb(rcb, [&]() {
+    uev->setcb(rcb, [this, uev, ecb]() {
         if (ecb) ecb();
         handle_close(uev);
     });
@@ -193,6 +322,43 @@ udpevent *server::add_udpev(int port, const UCallback &rcb,
     return uev;
 }
 
+/**
+ * @brief Adds one UDP event per sub-reactor, all bound to the same port.
+ *
+ * Every socket is bound with `SO_REUSEPORT`, so the kernel hashes incoming flows
+ * across them and each loop thread serves its own share of the port. Without a
+ * thread pool a single event on the main loop is created. Dynamic load adjustment
+ * may move loops around, so a pool created with `init_pool_noadjust` is
+ * recommended. Per-shard counters are available through `udpevent::getstats()`.
+ *
+ * @param port The port number shared by all shards.
+ * @param rcb The read callback for every shard.
+ * @param ecb The error callback for every shard.
+ *
+ * @return The created shards, one per loop.
+ */
+std::vector<udpevent *> server::add_udpev_shards(int port,
+                                                 const UCallback &rcb,
+                                                 const Callback &ecb) {
+    std::vector<eventloop *> loops = pool_.getloops();
+    if (loops.empty()) loops.push_back(&base_);
+    std::vector<udpevent *> shards;
+    for (eventloop *loop : loops) {
+        udpevent *uev = new udpevent(loop, port);
+        uev->setcb(rcb, [this, uev, ecb]() {
+            if (ecb) ecb();
+            handle_close(uev);
+        });
+        uev->enable_listen();
+        events_.emplace_back(uev);
+        shards.emplace_back(uev);
+    }
+    // 分片按loop顺序绑定，组内第i个socket属于绑定在loopcpus_[i]上的loop
+    if (cpudispatch_ && loopcpus_.size() == shards.size())
+        shards.front()->set_cpusteer(loopcpus_);
+    return shards;
+}
+
 /**
  * @brief Adds a signal event to the server for a specific signal.
  *
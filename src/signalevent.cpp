@@ -36,84 +36,231 @@ Author: MoonforDream
 #include "signalevent.h"
 #include "event.h"
 #include "eventloop.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <atomic>
+#include <map>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <sys/eventfd.h>
 
-using namespace moon;
+#define SIGINFO_BATCH 32
+
+namespace moon {
+
+    // 信号落到尚未屏蔽它的线程(订阅前已启动)时：在该线程屏蔽后重新投递给进程，
+    // 最终由signalfd取走，保留发送者pid/uid
+    static void forward(int signo, siginfo_t* info, void* ctx) {
+        int saved = errno;
+        // 返回时内核按uc_sigmask恢复屏蔽字，在此加入才能保持屏蔽
+        sigaddset(&static_cast<ucontext_t*>(ctx)->uc_sigmask, signo);
+        if (syscall(SYS_rt_sigqueueinfo, getpid(), signo, info) == -1) {
+            // 非主线程只能以负的si_code投递
+            siginfo_t copy = *info;
+            copy.si_code = SI_QUEUE;
+            syscall(SYS_rt_sigqueueinfo, getpid(), signo, &copy);
+        }
+        errno = saved;
+    }
+
+    // 进程内共享的信号中心：持有signalfd与订阅表。每个订阅实例在自己的loop上
+    // 监听该signalfd，先被唤醒的loop读出一批信号并投递给所有订阅者
+    struct sigcenter {
+        std::mutex mutex;
+        std::map<int, std::vector<signalevent*>> subs;
+        sigset_t mask;
+        int sfd = -1;
+        int users = 0;  // 持有center的实例数，归零时关闭signalfd
+
+        static std::mutex gmutex;
+        static sigcenter* center;
+        // 曾被订阅过的信号(位signo-1)，库线程启动时屏蔽，取消订阅后仍保留
+        static std::atomic<uint64_t> blocked;
+
+        static sigcenter* acquire() {
+            std::lock_guard<std::mutex> lock(gmutex);
+            if (!center) center = new sigcenter();
+            ++center->users;
+            return center;
+        }
+
+        static void release() {
+            std::lock_guard<std::mutex> lock(gmutex);
+            if (center && --center->users == 0) {
+                delete center;
+                center = nullptr;
+            }
+        }
+
+        sigcenter() {
+            sigemptyset(&mask);
+            sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+            if (sfd == -1) {
+                perror("signalfd");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        ~sigcenter() { ::close(sfd); }
+
+        void subscribe(signalevent* ev, int signo) {
+            uint64_t bit = signo >= 1 && signo <= 64 ? 1ULL << (signo - 1) : 0;
+            if (bit && !(blocked.fetch_or(bit) & bit)) {
+                struct sigaction sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_sigaction = forward;
+                sa.sa_flags = SA_SIGINFO | SA_RESTART;
+                sigfillset(&sa.sa_mask);
+                if (sigaction(signo, &sa, nullptr) == -1) perror("sigaction");
+            }
+            sigset_t one;
+            sigemptyset(&one);
+            sigaddset(&one, signo);
+            pthread_sigmask(SIG_BLOCK, &one, nullptr);
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& list = subs[signo];
+            if (std::find(list.begin(), list.end(), ev) != list.end()) return;
+            list.push_back(ev);
+            if (list.size() == 1) {
+                sigaddset(&mask, signo);
+                if (signalfd(sfd, &mask, 0) == -1) perror("signalfd");
+                // 已挂起的信号不会再触发可读，立即取走
+                drain();
+            }
+        }
+
+        void unsubscribe(signalevent* ev, int signo) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = subs.find(signo);
+            if (it == subs.end()) return;
+            auto& list = it->second;
+            list.erase(std::remove(list.begin(), list.end(), ev), list.end());
+            if (list.empty()) {
+                subs.erase(it);
+                sigdelset(&mask, signo);
+                if (signalfd(sfd, &mask, 0) == -1) perror("signalfd");
+            }
+        }
+
+        // 持锁调用，读空signalfd并投递
+        void drain() {
+            signalfd_siginfo infos[SIGINFO_BATCH];
+            while (true) {
+                ssize_t n = read(sfd, infos, sizeof(infos));
+                if (n <= 0) break;
+                size_t cnt = n / sizeof(signalfd_siginfo);
+                for (size_t i = 0; i < cnt; ++i) {
+                    auto it = subs.find(infos[i].ssi_signo);
+                    if (it == subs.end()) continue;
+                    for (auto ev : it->second) ev->post(infos[i]);
+                }
+            }
+        }
+
+        void dispatch() {
+            std::lock_guard<std::mutex> lock(mutex);
+            drain();
+        }
+    };
+
+    std::mutex sigcenter::gmutex;
+    sigcenter* sigcenter::center = nullptr;
+    std::atomic<uint64_t> sigcenter::blocked{0};
 
-signalevent* signalevent::sigev_ = nullptr;
+}  // namespace moon
+
+using namespace moon;
 
 /**
  * @brief Constructs a new `signalevent` instance.
  *
- * Initializes the `signalevent` with the provided event loop. It creates a pipe
- * for inter-thread communication, sets both ends of the pipe to non-blocking
- * mode, creates an associated `event` to listen for read events on the pipe's
- * read end, and sets up the callback for handling read events.
+ * Creates the eventfd through which other loops post deliveries to this instance
+ * and the `event` listening on it. Signals are subscribed with `add_signal`; any
+ * number of instances, on any loops, may subscribe to the same signal and each
+ * receives every delivery.
  *
  * @param base Pointer to the associated `eventloop`.
  */
 signalevent::signalevent(eventloop* base) : loop_(base) {
-    // 创建管道
-    if (pipe(pipe_fd_) == -1) {
-        perror("pipe");
+    evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evfd_ == -1) {
+        perror("eventfd");
         exit(EXIT_FAILURE);
     }
-
-    // 设置管道为非阻塞模式
-    setnonblock(pipe_fd_[0]);
-    setnonblock(pipe_fd_[1]);
-
-    ev_ = new event(loop_, pipe_fd_[0], EPOLLIN);
+    ev_ = new event(loop_, evfd_, EPOLLIN);
     ev_->setcb(std::bind(&signalevent::handle_read, this), nullptr, nullptr);
-    //    enable_listen();
-
-    // 保存实例指针，供信号处理函数使用
-    sigev_ = this;
 }
 
 /**
  * @brief Destructs the `signalevent` instance.
  *
- * Cleans up by deleting the associated `event`, closing both ends of the pipe,
- * and resetting the static instance pointer.
+ * Unsubscribes from all signals first, so no loop posts to this instance any more,
+ * then deletes the associated events and closes the eventfd. The shared
+ * `signalfd` is closed together with its last instance.
  */
 signalevent::~signalevent() {
+    if (center_) {
+        for (int signo : signals_) center_->unsubscribe(this, signo);
+        delete sigev_;
+        sigev_ = nullptr;
+        ::close(sigfd_);
+        center_ = nullptr;
+        sigcenter::release();
+    }
     if (ev_) {
         delete ev_;
         ev_ = nullptr;
     }
-    ::close(pipe_fd_[0]);
-    ::close(pipe_fd_[1]);
-    sigev_ = nullptr;
+    ::close(evfd_);
 }
 
 eventloop* signalevent::getloop() const { return loop_; }
 
 /**
- * @brief Adds a signal to be monitored by the `signalevent`.
+ * @brief Subscribes to a signal.
  *
- * Sets up the signal handler for the specified signal number (`signo`) using
- * `sigaction`. The handler is set to the static `handle_signal` function.
+ * The signal is blocked in the calling thread and read through the shared
+ * `signalfd`, which only sees signals blocked in every thread. The first
+ * subscription of an instance also registers that `signalfd` on its loop. Every
+ * thread the library creates (loop threads, `threadpool`/`lfthreadpool`/
+ * `wsthreadpool` workers and their adjust threads, `looptpool`'s manager, the
+ * watchdog) calls `block_subscribed()` when it starts, which blocks the signals
+ * subscribed so far. For threads that were already running, including the
+ * application's own, a handler is installed for the signal: when the kernel picks
+ * such a thread, the handler blocks the signal there and queues it to the process
+ * again, so it still reaches the `signalfd` with the sender's pid and uid (its
+ * `ssi_code` may become `SI_QUEUE`). This replaces any handler the application had
+ * for the signal.
  *
  * @param signo The signal number to monitor (e.g., `SIGINT`, `SIGTERM`).
  */
 void signalevent::add_signal(int signo) {
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = signalevent::handle_signal;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    if (sigaction(signo, &sa, nullptr) == -1) {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+    if (std::find(signals_.begin(), signals_.end(), signo) != signals_.end())
+        return;
+    if (!center_) {
+        center_ = sigcenter::acquire();
+        // 同一loop上可能有多个实例，各自注册一个dup出的描述符
+        sigfd_ = dup(center_->sfd);
+        if (sigfd_ == -1) {
+            perror("dup");
+            exit(EXIT_FAILURE);
+        }
+        sigev_ = new event(loop_, sigfd_, EPOLLIN);
+        sigev_->setcb(std::bind(&signalevent::handle_signal, this), nullptr,
+                      nullptr);
+        if (listening_) sigev_->enable_listen();
     }
+    signals_.push_back(signo);
+    center_->subscribe(this, signo);
 }
 
 /**
  * @brief Adds multiple signals to be monitored by the `signalevent`.
  *
- * Iterates over the provided vector of signal numbers and sets up handlers for
- * each using `add_signal(int)`.
+ * Iterates over the provided vector of signal numbers and subscribes to each
+ * using `add_signal(int)`.
  *
  * @param signals A vector of signal numbers to monitor (e.g., `{SIGINT,
  * SIGTERM}`).
@@ -124,37 +271,116 @@ void signalevent::add_signal(const std::vector<int>& signals) {
     }
 }
 
+/**
+ * @brief Unsubscribes from a signal.
+ *
+ * When no instance is subscribed any more, the signal is removed from the
+ * `signalfd` but stays blocked, so later occurrences stay pending.
+ *
+ * @param signo The signal number.
+ */
+void signalevent::del_signal(int signo) {
+    auto it = std::find(signals_.begin(), signals_.end(), signo);
+    if (it == signals_.end()) return;
+    signals_.erase(it);
+    center_->unsubscribe(this, signo);
+}
+
 void signalevent::setcb(const Callback& cb) { cb_ = cb; }
 
+void signalevent::setinfocb(const ICallback& cb) { infocb_ = cb; }
+
 void signalevent::enable_listen() {
+    if (listening_) return;
+    listening_ = true;
     if (ev_) ev_->enable_listen();
+    if (sigev_) sigev_->enable_listen();
 }
 
 void signalevent::del_listen() {
+    if (!listening_) return;
+    listening_ = false;
     if (ev_) ev_->del_listen();
+    if (sigev_) sigev_->del_listen();
 }
 
-void signalevent::handle_signal(int signo) {
-    // 在信号处理函数中，向管道写入信号编号
-    uint8_t sig = static_cast<uint8_t>(signo);
-    if (sigev_) {
-        ssize_t n = write(sigev_->pipe_fd_[1], &sig, sizeof(sig));
-        (void)n;  // 忽略写入的返回值
+/**
+ * @brief Blocks the signals subscribed so far in the calling thread.
+ *
+ * Every thread created by the library calls it when it starts, so a subscribed
+ * signal can only be consumed through the `signalfd`, whichever library thread it
+ * was aimed at. Does nothing in a process that never subscribed to a signal, so
+ * handlers installed by the application keep reaching every thread.
+ */
+void signalevent::block_subscribed() {
+    uint64_t bits = sigcenter::blocked.load();
+    if (bits == 0) return;
+    sigset_t set;
+    sigemptyset(&set);
+    for (int sig = 1; sig <= 64; ++sig) {
+        if (bits & (1ULL << (sig - 1))) sigaddset(&set, sig);
+    }
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+/**
+ * @brief Queues a delivery; called by the loop that read the `signalfd`.
+ *
+ * Only the first delivery of a batch writes the eventfd, so a burst of signals
+ * wakes the loop once.
+ *
+ * @param info The signal information read from the `signalfd`.
+ */
+void signalevent::post(const signalfd_siginfo& info) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake = pending_.empty();
+        pending_.push_back(info);
+    }
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t n = write(evfd_, &one, sizeof(one));
+        (void)n;
     }
 }
 
+/**
+ * @brief Delivers the queued signals on the loop thread.
+ *
+ * The information callback runs first, then the plain callback with the signal
+ * number, for every queued delivery in order.
+ */
 void signalevent::handle_read() {
-    uint8_t signals[1024];
-    ssize_t n = read(pipe_fd_[0], signals, sizeof(signals));
-    if (n > 0) {
-        for (ssize_t i = 0; i < n; ++i) {
-            int sig = signals[i];
-            if (cb_) cb_(sig);
-        }
+    uint64_t cnt;
+    ssize_t n = read(evfd_, &cnt, sizeof(cnt));
+    (void)n;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handling_.swap(pending_);
     }
+    for (auto& info : handling_) {
+        if (infocb_) infocb_(info);
+        if (cb_) cb_(info.ssi_signo);
+    }
+    handling_.clear();
 }
 
-void signalevent::disable_cb() { cb_ = nullptr; }
+/**
+ * @brief Reads the shared `signalfd` on this instance's loop.
+ *
+ * Posts every delivery to all subscribers and handles this instance's own share
+ * right away, without waiting for its eventfd.
+ */
+void signalevent::handle_signal() {
+    center_->dispatch();
+    handle_read();
+}
+
+void signalevent::disable_cb() {
+    cb_ = nullptr;
+    infocb_ = nullptr;
+}
 
 signalevent::Callback signalevent::getcb() { return cb_; }
 
@@ -0,0 +1,108 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "sockopts.h"
+#include <cstdio>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace moon;
+
+namespace {
+    bool setopt(int fd, int level, int name, int val, const char* what) {
+        if (setsockopt(fd, level, name, &val, sizeof(val)) == -1) {
+            perror(what);
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+/**
+ * @brief Applies the listener part of the profile to a listening socket.
+ *
+ * Called after `bind` and before `listen`: buffer sizes set here are inherited by
+ * accepted connections and determine the window scale they advertise. Failures are
+ * reported with `perror` but do not stop the remaining options, since some (e.g.
+ * fast open) may be disabled by the system.
+ *
+ * @param fd The listening socket.
+ * @return Whether every configured option was applied.
+ */
+bool sockopts::apply_listen(int fd) const {
+    bool ok = true;
+    if (sndbuf > 0)
+        ok &= setopt(fd, SOL_SOCKET, SO_SNDBUF, sndbuf, "setsockopt SO_SNDBUF");
+    if (rcvbuf > 0)
+        ok &= setopt(fd, SOL_SOCKET, SO_RCVBUF, rcvbuf, "setsockopt SO_RCVBUF");
+    if (defer_accept > 0)
+        ok &= setopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept,
+                     "setsockopt TCP_DEFER_ACCEPT");
+    if (fastopen > 0)
+        ok &= setopt(fd, IPPROTO_TCP, TCP_FASTOPEN, fastopen,
+                     "setsockopt TCP_FASTOPEN");
+    return ok;
+}
+
+/**
+ * @brief Applies the per-connection part of the profile to a connected socket.
+ *
+ * `TCP_QUICKACK` is not permanent; the kernel may fall back to delayed ACKs, so
+ * it only affects the start of the connection unless set again.
+ *
+ * @param fd The connected socket.
+ * @return Whether every configured option was applied.
+ */
+bool sockopts::apply_conn(int fd) const {
+    bool ok = true;
+    if (nodelay)
+        ok &= setopt(fd, IPPROTO_TCP, TCP_NODELAY, 1, "setsockopt TCP_NODELAY");
+    if (notsent_lowat > 0)
+        ok &= setopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, notsent_lowat,
+                     "setsockopt TCP_NOTSENT_LOWAT");
+    if (quickack)
+        ok &= setopt(fd, IPPROTO_TCP, TCP_QUICKACK, 1,
+                     "setsockopt TCP_QUICKACK");
+    if (keepidle > 0) {
+        ok &= setopt(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "setsockopt SO_KEEPALIVE");
+        ok &= setopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, keepidle,
+                     "setsockopt TCP_KEEPIDLE");
+        if (keepintvl > 0)
+            ok &= setopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, keepintvl,
+                         "setsockopt TCP_KEEPINTVL");
+        if (keepcnt > 0)
+            ok &= setopt(fd, IPPROTO_TCP, TCP_KEEPCNT, keepcnt,
+                         "setsockopt TCP_KEEPCNT");
+    }
+    return ok;
+}
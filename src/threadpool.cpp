@@ -32,6 +32,8 @@ Author: MoonforDream
 */
 
 #include "threadpool.h"
+#include "signalevent.h"
+#include <algorithm>
 #include <chrono>
 #include <mutex>
 #include <unistd.h>
@@ -41,109 +43,157 @@ using namespace moon;
 /**
  * @brief Initializes the thread pool.
  *
- * This function sets the initial state of the thread pool, including the number
- * of running threads, live threads, and threads scheduled to exit. It
- * determines the maximum number of threads based on the hardware concurrency,
- * starts the adjustment thread, and initializes the minimum number of worker
- * threads.
+ * Starts the minimum number of worker threads and the adjustment thread.
  */
 void threadpool::init() {
-    run_num = 0;
-    live_num = 0;
-    exit_num = 0;
-    max_thr_num = std::thread::hardware_concurrency() + 1;
+    std::unique_lock<std::mutex> lock(mx);
+    for (int i = 0; i < min_thr_num; ++i) spawn();
+    lock.unlock();
     adjust_thr = std::thread([this] { this->adjust_task(); });
-    for (int i = 0; i < min_thr_num; ++i) {
-        threads.emplace_back([this] { this->t_task(); });
-    }
+}
+
+uint64_t threadpool::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void threadpool::spawn() {
+    ++live_num;
+    threads.emplace_back([this] { this->t_task(); });
 }
 
 /**
  * @brief Worker thread task function.
  *
- * This function defines the main loop for each worker thread in the thread
- * pool. It continuously waits for tasks to be available, executes them, and
- * handles thread shutdown requests. The function ensures thread-safe access to
- * the task queue and manages the thread's running and live counts.
+ * Takes tasks from the queue until shutdown, recording how long each one waited.
+ * A worker idle for `DEFAULT_TIME` seconds exits while the pool is above its
+ * minimum size; the adjustment thread joins it later. On shutdown the queue is
+ * drained before the workers exit.
  */
 void threadpool::t_task() {
-    while (1) {
-        std::unique_lock<std::mutex> lock(mx);
-        task_cv.wait(lock, [this] {
-            return !tasks.empty() || shutdown || exit_num > 0;
-        });
-        if (exit_num > 0) {
-            exit_num--;
-            return;
+    signalevent::block_subscribed();
+    std::unique_lock<std::mutex> lock(mx);
+    while (true) {
+        if (tasks.empty()) {
+            if (shutdown) break;
+            ++idle_num;
+            bool woke = task_cv.wait_for(
+                lock, std::chrono::seconds(DEFAULT_TIME),
+                [this] { return !tasks.empty() || shutdown; });
+            --idle_num;
+            if (!woke && live_num > min_thr_num) break;
+            continue;
         }
-        if (shutdown && tasks.empty()) {
-            return;
-        }
-        auto task = tasks.front();
-        tasks.pop();
+        item task = std::move(tasks.front());
+        tasks.pop_front();
         lock.unlock();
-        ++run_num;
-        --live_num;
-        task();
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t waited = now_us() - task.enqueue_us;
+        wait_us.store((wait_us.load(std::memory_order_relaxed) * 7 + waited) / 8,
+                      std::memory_order_relaxed);
+        task.fn();
+        completed.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
     }
+    --live_num;
+    exited.push_back(std::this_thread::get_id());
 }
 
 /**
  * @brief Shuts down the thread pool.
  *
- * This function initiates the shutdown process for the thread pool. It sets the
- * shutdown flag, detaches the adjustment thread, notifies all worker threads to
- * terminate, and joins all worker threads to ensure a clean shutdown.
+ * Rejects new tasks, lets the workers finish the queued ones, and joins the
+ * workers and the adjustment thread.
  */
 void threadpool::t_shutdown() {
     {
         std::unique_lock<std::mutex> lock(mx);
+        if (shutdown) return;
         shutdown = true;
     }
-    adjust_thr.detach();
     task_cv.notify_all();
+    adjust_cv.notify_all();
+    if (adjust_thr.joinable()) adjust_thr.join();
     for (auto& t : threads) {
         if (t.joinable()) t.join();
     }
+    threads.clear();
+    exited.clear();
+}
+
+/**
+ * @brief Joins workers that exited after being idle.
+ */
+void threadpool::reap() {
+    std::vector<std::thread> done;
+    {
+        std::unique_lock<std::mutex> lock(mx);
+        for (auto id : exited) {
+            auto it = std::find_if(threads.begin(), threads.end(),
+                                   [id](const std::thread& t) {
+                                       return t.get_id() == id;
+                                   });
+            if (it != threads.end()) {
+                done.emplace_back(std::move(*it));
+                threads.erase(it);
+            }
+        }
+        exited.clear();
+    }
+    for (auto& t : done) t.join();
 }
 
 /**
- * @brief Adjusts the number of worker threads based on the workload.
+ * @brief Adjusts the number of worker threads based on queue wait time.
  *
- * This function runs in a separate adjustment thread and periodically checks
- * the workload to determine if more threads need to be added or existing
- * threads should be terminated. It ensures that the number of live threads
- * stays within the defined minimum and maximum thread limits, adding up to 10
- * new threads or removing up to 10 threads as needed.
+ * Every `POOL_ADJUST_MSEC` it joins workers that exited and, while tasks are
+ * queued with no idle worker and the average wait exceeds `POOL_GROW_WAIT_US`,
+ * adds one worker per queued task up to the maximum. Shrinking is left to the
+ * workers themselves through their idle timeout.
  */
 void threadpool::adjust_task() {
+    signalevent::block_subscribed();
+    std::unique_lock<std::mutex> lock(mx);
     while (!shutdown) {
-        std::this_thread::sleep_for(std::chrono::seconds(DEFAULT_TIME));
-        {
-            int size = threads.size();
-            if (tasks.size() > live_num && live_num < max_thr_num &&
-                size < max_thr_num) {
-                int add = 0;
-                std::unique_lock<std::mutex> lock(mx);
-                for (int i = size; i < max_thr_num && add < 10; ++i) {
-                    threads.emplace_back([this] { this->t_task(); });
-                    add++;
-                    live_num++;
-                }
-                lock.unlock();
-            }
-            if (run_num * 2 < live_num && live_num > min_thr_num) {
-                exit_num =
-                    live_num - min_thr_num >= 10 ? 10 : live_num - min_thr_num;
-                int x = exit_num;
-                std::unique_lock<std::mutex> lock(mx);
-                for (int i = 0; i < x; ++i) {
-                    task_cv.notify_one();
-                    live_num--;
-                }
-                lock.unlock();
-            }
+        adjust_cv.wait_for(lock, std::chrono::milliseconds(POOL_ADJUST_MSEC));
+        if (shutdown) break;
+        if (!exited.empty()) {
+            lock.unlock();
+            reap();
+            lock.lock();
         }
+        if (tasks.empty() || idle_num > 0) continue;
+        uint64_t oldest = now_us() - tasks.front().enqueue_us;
+        if (std::max(oldest, getwait_us()) <= POOL_GROW_WAIT_US) continue;
+        size_t add = tasks.size();
+        while (add-- > 0 && live_num < max_thr_num) spawn();
     }
 }
+
+void threadpool::set_maxqueue(size_t n) {
+    std::unique_lock<std::mutex> lock(mx);
+    max_queue = n;
+}
+
+int threadpool::getthreads() {
+    std::unique_lock<std::mutex> lock(mx);
+    return live_num;
+}
+
+int threadpool::getidle() {
+    std::unique_lock<std::mutex> lock(mx);
+    return idle_num;
+}
+
+size_t threadpool::getpending() {
+    std::unique_lock<std::mutex> lock(mx);
+    return tasks.size();
+}
+
+uint64_t threadpool::getwait_us() const {
+    return wait_us.load(std::memory_order_relaxed);
+}
+
+uint64_t threadpool::getcompleted() const {
+    return completed.load(std::memory_order_relaxed);
+}
@@ -39,28 +39,34 @@ namespace moon {
     /**
      * @brief Adds a new task to the thread pool.
      *
-     * This templated function allows users to add tasks with varying arguments
-     * to the thread pool. It binds the provided function and arguments into a
-     * callable task, ensures the thread pool is not shutting down, and notifies
-     * one of the worker threads to execute the task.
+     * Binds the function and arguments into a task and queues it with its enqueue
+     * time. An idle worker is woken only if there is one; when none is idle and
+     * the oldest queued task has already waited longer than `POOL_GROW_WAIT_US`,
+     * a worker is added right away (up to the maximum).
      *
      * @tparam _Fn The type of the function to be added as a task.
      * @tparam _Args The types of the arguments to be passed to the function.
      * @param fn The function to be executed by a worker thread.
      * @param args The arguments to be passed to the function.
+     * @return false if the pool is shut down or the queue is full.
      */
     template <typename _Fn, typename... _Args>
-    void threadpool::add_task(_Fn&& fn, _Args&&... args) {
+    bool threadpool::add_task(_Fn&& fn, _Args&&... args) {
+        auto f = std::bind(std::forward<_Fn>(fn), std::forward<_Args>(args)...);
+        uint64_t now = now_us();
+        bool wake;
         {
-            auto f =
-                std::bind(std::forward<_Fn>(fn), std::forward<_Args>(args)...);
-            {
-                std::unique_lock<std::mutex> lock(mx);
-                if (shutdown) return;
-                tasks.emplace(std::move(f));
-            }
-            task_cv.notify_one();
+            std::unique_lock<std::mutex> lock(mx);
+            if (shutdown) return false;
+            if (max_queue > 0 && tasks.size() >= max_queue) return false;
+            tasks.push_back(item{std::move(f), now});
+            wake = idle_num > 0;
+            if (!wake && live_num < max_thr_num &&
+                now - tasks.front().enqueue_us > POOL_GROW_WAIT_US)
+                spawn();
         }
+        if (wake) task_cv.notify_one();
+        return true;
     }
 }  // namespace moon
 
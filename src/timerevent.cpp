@@ -127,6 +127,26 @@ eventloop *timerevent::getloop() const { return loop_; }
 
 void timerevent::setcb(const moon::timerevent::Callback &cb) { cb_ = cb; }
 
+/**
+ * @brief Re-arms the timer with a new timeout.
+ *
+ * Keeps the timer's periodicity. A pending expiration is discarded, and a timeout of
+ * 0 disarms the timer without removing it from the event loop.
+ *
+ * @param timeout_ms The new timeout in milliseconds.
+ */
+void timerevent::reset(int timeout_ms) {
+    timeout_ms_ = timeout_ms;
+    itimerspec tvalue;
+    tvalue.it_value.tv_sec = timeout_ms_ / 1000;
+    tvalue.it_value.tv_nsec = (timeout_ms_ % 1000) * 1000000;
+    tvalue.it_interval = {0, 0};
+    if (periodic_) tvalue.it_interval = tvalue.it_value;
+    if (timerfd_settime(fd_, 0, &tvalue, NULL) == -1) {
+        perror("timerfd_settime error");
+    }
+}
+
 void timerevent::enable_listen() {
     if (ev_) {
         ev_->enable_listen();
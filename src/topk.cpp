@@ -0,0 +1,160 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "topk.h"
+#include <algorithm>
+
+using namespace moon;
+
+namespace {
+    uint64_t mono_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    // 库加载时的参考点，换算时用之后的耗时估计计数器频率
+    const uint64_t basecycles = rdcycles();
+    const uint64_t basens = mono_ns();
+}  // namespace
+
+/**
+ * @brief Converts a `rdcycles()` difference to nanoseconds.
+ *
+ * The counter frequency is estimated from the cycles and wall time elapsed since
+ * the library was loaded, so it needs no calibration pause. Within the first
+ * millisecond the estimate waits until that much time has passed.
+ *
+ * @param cycles The number of cycles.
+ * @return The equivalent number of nanoseconds.
+ */
+uint64_t moon::cycles_to_ns(uint64_t cycles) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ns = mono_ns() - basens;
+    while (ns < 1000000) ns = mono_ns() - basens;
+    uint64_t elapsed = rdcycles() - basecycles;
+    if (elapsed == 0) return 0;
+    return (uint64_t)((double)cycles * ns / elapsed);
+#else
+    return cycles;
+#endif
+}
+
+/**
+ * @brief Constructs a sketch tracking at most `k` keys.
+ *
+ * Any key whose share of the total cost is above 1/k is guaranteed to be kept.
+ *
+ * @param k The number of slots.
+ */
+topk::topk(size_t k) : k_(k > 0 ? k : 1) { slots_.reserve(k_); }
+
+/**
+ * @brief Adds cost to a key.
+ *
+ * A key not yet tracked takes over the slot with the smallest cost when the sketch
+ * is full, inheriting that cost as its error bound (Space-Saving).
+ *
+ * @param key The key, e.g. a connection's address.
+ * @param fd The key's file descriptor, kept for reporting.
+ * @param cost The cost to add.
+ */
+void topk::add(const void* key, int fd, uint64_t cost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_ += cost;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        slots_[it->second].cost += cost;
+        return;
+    }
+    if (slots_.size() < k_) {
+        index_[key] = slots_.size();
+        slots_.push_back({key, fd, cost, 0});
+        return;
+    }
+    size_t min = 0;
+    for (size_t i = 1; i < slots_.size(); ++i) {
+        if (slots_[i].cost < slots_[min].cost) min = i;
+    }
+    talker& slot = slots_[min];
+    index_.erase(slot.key);
+    index_[key] = min;
+    slot.key = key;
+    slot.fd = fd;
+    slot.error = slot.cost;
+    slot.cost += cost;
+}
+
+void topk::remove(const void* key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return;
+    size_t idx = it->second;
+    index_.erase(it);
+    if (idx != slots_.size() - 1) {
+        slots_[idx] = slots_.back();
+        index_[slots_[idx].key] = idx;
+    }
+    slots_.pop_back();
+}
+
+/**
+ * @brief Returns the `n` keys with the highest cost, highest first.
+ *
+ * @param n The maximum number of entries.
+ * @return A copy of the entries.
+ */
+std::vector<talker> topk::top(size_t n) const {
+    std::vector<talker> res;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        res = slots_;
+    }
+    std::sort(res.begin(), res.end(), [](const talker& a, const talker& b) {
+        return a.cost > b.cost;
+    });
+    if (res.size() > n) res.resize(n);
+    return res;
+}
+
+uint64_t topk::total() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+}
+
+void topk::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.clear();
+    index_.clear();
+    total_ = 0;
+}
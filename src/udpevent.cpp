@@ -36,10 +36,69 @@ Author: MoonforDream
 #include "eventloop.h"
 #include "event.h"
 #include "wrap.h"
+#include <algorithm>
 #include <cstring>
+#include <vector>
+#include <netinet/udp.h>
+#include <linux/filter.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
 
 using namespace moon;
 
+namespace {
+    // 每个loop线程共享的recvmmsg接收槽，按最大的mtu/batch扩容
+    struct mmsgslots {
+        std::vector<char> data;
+        std::vector<mmsghdr> msgs;
+        std::vector<iovec> iovs;
+        std::vector<sockaddr_in> addrs;
+        std::vector<char> ctrl;  // GRO段长cmsg
+        size_t mtu = 0;
+
+        void reserve(size_t m, int batch) {
+            if (m <= mtu && msgs.size() >= (size_t)batch) return;
+            mtu = std::max(mtu, m);
+            size_t n = std::max(msgs.size(), (size_t)batch);
+            data.resize(mtu * n);
+            msgs.resize(n);
+            iovs.resize(n);
+            addrs.resize(n);
+            ctrl.resize(CMSG_SPACE(sizeof(int)) * n);
+        }
+
+        // 每次接收前重置，recvmmsg会改写长度字段
+        void prepare(size_t m, int batch, bool gro) {
+            for (int i = 0; i < batch; ++i) {
+                iovs[i].iov_base = &data[i * mtu];
+                iovs[i].iov_len = m;
+                memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                if (gro) {
+                    msgs[i].msg_hdr.msg_control =
+                        &ctrl[i * CMSG_SPACE(sizeof(int))];
+                    msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+                }
+                msgs[i].msg_len = 0;
+            }
+        }
+    };
+
+    thread_local mmsgslots slots;
+
+    uint64_t peerkey(const sockaddr_in& addr) {
+        return ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+    }
+}  // namespace
+
 /**
  * @brief Constructs a new `udpevent` instance.
  *
@@ -60,6 +119,26 @@ udpevent::udpevent(eventloop* base, int port)
     if (port != -1) init_sock(port);
 }
 
+/**
+ * @brief Constructs a connected session socket for one peer.
+ *
+ * The socket is bound to `port` with `SO_REUSEPORT` and `connect`ed to `peer`, so
+ * the kernel delivers that peer's datagrams to it instead of the shared socket. On
+ * failure the event is left without a socket (`getfd`-less, `fd_` is -1).
+ *
+ * @param base Pointer to the associated `eventloop`.
+ * @param port The local port shared with the listening socket.
+ * @param peer The remote address of the session.
+ */
+udpevent::udpevent(eventloop* base, int port, const sockaddr_in& peer)
+    : loop_(base),
+      fd_(-1),
+      ev_(nullptr),
+      receive_cb_(nullptr),
+      started_(false) {
+    init_session(port, peer);
+}
+
 /**
  * @brief Destructs the `udpevent` instance.
  *
@@ -67,6 +146,13 @@ udpevent::udpevent(eventloop* base, int port)
  * descriptor, and resetting internal pointers to prevent dangling references.
  */
 udpevent::~udpevent() {
+    if (flushq_) loop_->del_pending_flush(this);
+    if (connected_ && sessions_) {
+        std::lock_guard<std::recursive_mutex> lock(sessions_->mutex);
+        auto it = sessions_->peers.find(peerkey_);
+        if (it != sessions_->peers.end() && it->second == this)
+            sessions_->peers.erase(it);
+    }
     if (ev_) {
         delete ev_;
         ev_ = nullptr;
@@ -110,8 +196,39 @@ void udpevent::init_sock(int port) {
         ::close(fd_);
         exit(EXIT_FAILURE);
     }
+    port_ = port;
+    ev_ = new event(loop_, fd_, EPOLLIN | EPOLLET);
+    ev_->setcb(std::bind(&udpevent::handle_receive, this),
+               std::bind(&udpevent::handle_send, this), nullptr);
+}
+
+void udpevent::init_session(int port, const sockaddr_in& peer) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("UDP session socket creation failed");
+        return;
+    }
+    setnonblock(fd);
+    setreuse(fd);
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&local, sizeof(local)) < 0 ||
+        connect(fd, (const struct sockaddr*)&peer, sizeof(peer)) < 0) {
+        perror("UDP session bind/connect failed");
+        ::close(fd);
+        return;
+    }
+    fd_ = fd;
+    port_ = port;
+    peer_ = peer;
+    peerkey_ = peerkey(peer);
+    connected_ = true;
     ev_ = new event(loop_, fd_, EPOLLIN | EPOLLET);
-    ev_->setcb(std::bind(&udpevent::handle_receive, this), nullptr, nullptr);
+    ev_->setcb(std::bind(&udpevent::handle_receive, this),
+               std::bind(&udpevent::handle_send, this), nullptr);
 }
 
 /**
@@ -149,10 +266,35 @@ void udpevent::setecb(const udpevent::Callback& ecb) {
     update_ep();
 }
 
+/**
+ * @brief Switches to batched, per-datagram receive.
+ *
+ * Datagrams are read with `recvmmsg` into packet slots shared by all UDP events of the
+ * calling loop thread, and `dcb` is invoked once per datagram with a view of its payload
+ * and sender. The view is only valid during the callback. Datagram boundaries are kept
+ * and `inbuff_` is no longer used. Passing an empty callback restores the `recvfrom` path.
+ *
+ * @param dcb The per-datagram callback.
+ * @param mtu The largest expected datagram; longer ones are truncated and counted.
+ * @param batch The number of datagrams requested per `recvmmsg` call.
+ */
+void udpevent::setdcb(const DCallback& dcb, size_t mtu, int batch) {
+    dgram_cb_ = dcb;
+    mtu_ = std::min<size_t>(std::max<size_t>(mtu, 1), IOBUF);
+    if (gro_) mtu_ = IOBUF;
+    batch_ = std::max(batch, 1);
+    update_ep();
+}
+
+size_t udpevent::gettruncated() const { return stats_.truncated; }
+
+const udpstats& udpevent::getstats() const { return stats_; }
+
 void udpevent::enable_listen() {
     if (started_) return;
     if (ev_) ev_->enable_listen();
     started_ = true;
+    if (sendhead_ < sendq_.size() && !sendbatch_) flush_queue();
 }
 
 void udpevent::del_listen() {
@@ -207,21 +349,448 @@ std::string udpevent::receive() {
     return inbuff_.remove();
 }
 
+/**
+ * @brief Returns a pointer to the readable input data without copying it.
+ *
+ * @return Pointer to the first of `readbytes()` contiguous readable bytes.
+ */
+const char* udpevent::peek() const { return inbuff_.peek(); }
+
+size_t udpevent::readbytes() const { return inbuff_.readbytes(); }
+
+/**
+ * @brief Consumes input data that was accessed through `peek()`.
+ *
+ * @param len The number of bytes to discard from the input buffer.
+ */
+void udpevent::retrieve(size_t len) { inbuff_.retrieve(len); }
+
 /**
  * @brief Sends data to a specific address using the UDP socket.
  *
- * Sends the provided `data` string to the specified `addr` using the `sendto`
- * system call. If the send operation fails, it logs an error message.
+ * Convenience overload of `send_to(const char*, size_t, const sockaddr_in&)`.
  *
  * @param data The `std::string` containing the data to be sent.
  * @param addr The `sockaddr_in` structure containing the destination address.
  */
 void udpevent::send_to(const std::string& data, const sockaddr_in& addr) {
-    ssize_t n = sendto(fd_, data.c_str(), data.size(), 0,
-                       (struct sockaddr*)&addr, sizeof(addr));
-    if (n < 0) {
-        perror("sendto failed");
+    send_to(data.data(), data.size(), addr);
+}
+
+/**
+ * @brief Sends `len` bytes starting at `data` to a specific address.
+ *
+ * Sends immediately unless batching is on or earlier datagrams are still queued.
+ * A datagram the socket cannot take right now is queued and sent on `EPOLLOUT`
+ * instead of being dropped.
+ *
+ * @param data Pointer to the datagram payload.
+ * @param len The payload length in bytes.
+ * @param addr The `sockaddr_in` structure containing the destination address.
+ */
+void udpevent::send_to(const char* data, size_t len, const sockaddr_in& addr) {
+    iovec iov{const_cast<char*>(data), len};
+    send_to(&iov, 1, addr);
+}
+
+/**
+ * @brief Sends the concatenation of `iov` as one datagram to a specific address.
+ *
+ * @param iov The payload pieces.
+ * @param iovcnt The number of entries in `iov`.
+ * @param addr The `sockaddr_in` structure containing the destination address.
+ */
+void udpevent::send_to(const iovec* iov, int iovcnt, const sockaddr_in& addr) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i) len += iov[i].iov_len;
+    if (!sendbatch_ && sendhead_ == sendq_.size()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        // 已连接的会话不传地址
+        if (!connected_) {
+            msg.msg_name = const_cast<sockaddr_in*>(&addr);
+            msg.msg_namelen = sizeof(addr);
+        }
+        msg.msg_iov = const_cast<iovec*>(iov);
+        msg.msg_iovlen = iovcnt;
+        if (sendmsg(fd_, &msg, 0) >= 0) {
+            ++stats_.txpkts;
+            stats_.txbytes += len;
+            return;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+            perror("sendto failed");
+            ++stats_.drops;
+            return;
+        }
+    }
+    enqueue(iov, iovcnt, len, addr);
+}
+
+/**
+ * @brief Enables or disables end-of-iteration batching of outgoing datagrams.
+ *
+ * While enabled, `send_to` only queues; the owning `eventloop` sends the whole
+ * queue with `sendmmsg` after the callbacks of the current iteration have run.
+ * Must be used from the loop thread.
+ *
+ * @param on Whether to batch outgoing datagrams.
+ */
+void udpevent::set_sendbatch(bool on) {
+    sendbatch_ = on;
+    if (!on && sendhead_ < sendq_.size()) flush_queue();
+}
+
+void udpevent::set_sendlimit(size_t bytes) { sendlimit_ = bytes; }
+
+size_t udpevent::getqueued() const { return sendq_.size() - sendhead_; }
+
+size_t udpevent::getdrops() const { return stats_.drops; }
+
+void udpevent::enqueue(const iovec* iov, int iovcnt, size_t len,
+                       const sockaddr_in& addr) {
+    size_t off = sendbuf_.size();
+    if (off - (sendhead_ < sendq_.size() ? sendq_[sendhead_].off : off) +
+            len > sendlimit_) {
+        ++stats_.drops;
+        return;
+    }
+    sendbuf_.resize(off + len);
+    for (int i = 0; i < iovcnt; ++i) {
+        memcpy(&sendbuf_[off], iov[i].iov_base, iov[i].iov_len);
+        off += iov[i].iov_len;
+    }
+    sendq_.push_back(dgram{off - len, len, addr});
+    if (sendbatch_) {
+        if (!flushq_ && !writing_) {
+            flushq_ = true;
+            loop_->add_pending_flush(this);
+        }
+    } else if (!writing_ && started_) {
+        writing_ = true;
+        ev_->enable_write();
+    }
+}
+
+/**
+ * @brief Sends queued datagrams with `sendmmsg` until the queue is empty or the
+ * socket would block.
+ *
+ * Waits for `EPOLLOUT` while datagrams remain. A coalesced `UDP_SEGMENT` run the
+ * kernel refuses (`EINVAL`/`EMSGSIZE`, e.g. segment plus headers above the path
+ * MTU) is resent one datagram per message; GSO is only turned off for `EIO`, when
+ * the device cannot segment at all. A datagram rejected with a hard error is
+ * dropped and counted so it cannot block the queue.
+ */
+void udpevent::flush_queue() {
+    const int maxbatch = 64;
+    // 单次GSO发送的段数与总长上限
+    const size_t maxsegs = 64, maxgso = 65000;
+    mmsghdr msgs[maxbatch];
+    iovec iovs[maxbatch];
+    size_t runs[maxbatch];  // 每条消息包含的数据报数
+    char ctrl[maxbatch][CMSG_SPACE(sizeof(uint16_t))];
+    while (sendhead_ < sendq_.size()) {
+        int cnt = 0;
+        size_t pos = sendhead_;
+        while (cnt < maxbatch && pos < sendq_.size()) {
+            dgram& d = sendq_[pos];
+            size_t run = 1, bytes = d.len;
+            // 合并后续同目标数据报：除最后一个外长度须与首个相同
+            while (gso_ && d.len > 0 && pos + run < sendq_.size() &&
+                   run < maxsegs) {
+                const dgram& e = sendq_[pos + run];
+                if (e.len > d.len || e.len == 0 || bytes + e.len > maxgso ||
+                    e.addr.sin_addr.s_addr != d.addr.sin_addr.s_addr ||
+                    e.addr.sin_port != d.addr.sin_port)
+                    break;
+                bytes += e.len;
+                ++run;
+                if (e.len < d.len) break;
+            }
+            iovs[cnt].iov_base = &sendbuf_[d.off];
+            iovs[cnt].iov_len = bytes;
+            memset(&msgs[cnt], 0, sizeof(mmsghdr));
+            if (!connected_) {
+                msgs[cnt].msg_hdr.msg_name = &d.addr;
+                msgs[cnt].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            }
+            msgs[cnt].msg_hdr.msg_iov = &iovs[cnt];
+            msgs[cnt].msg_hdr.msg_iovlen = 1;
+            if (run > 1) {
+                msgs[cnt].msg_hdr.msg_control = ctrl[cnt];
+                msgs[cnt].msg_hdr.msg_controllen = sizeof(ctrl[cnt]);
+                cmsghdr* cm = CMSG_FIRSTHDR(&msgs[cnt].msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gs = d.len;
+                memcpy(CMSG_DATA(cm), &gs, sizeof(gs));
+            }
+            runs[cnt++] = run;
+            pos += run;
+        }
+        int n = sendmmsg(fd_, msgs, cnt, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                break;
+            if (errno == EIO && gso_ && runs[0] > 1) {
+                // 设备不支持分段卸载，退回逐个发送
+                fprintf(stderr, "UDP GSO failed, disabled\n");
+                gso_ = false;
+                continue;
+            }
+            if ((errno == EINVAL || errno == EMSGSIZE) && runs[0] > 1) {
+                // 该组分段被拒绝，不合并重发，超过MTU的由IP层分片
+                if (!send_plain(runs[0])) break;
+                continue;
+            }
+            perror("sendmmsg failed");
+            stats_.drops += runs[0];
+            sendhead_ += runs[0];
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            sendhead_ += runs[i];
+            stats_.txpkts += runs[i];
+            stats_.txbytes += iovs[i].iov_len;
+        }
+    }
+    if (sendhead_ == sendq_.size()) {
+        sendq_.clear();
+        sendbuf_.clear();
+        sendhead_ = 0;
+        if (writing_) {
+            writing_ = false;
+            ev_->disable_write();
+        }
+        return;
+    }
+    // 已发送部分过半时压缩队列，避免sendbuf_持续增长
+    if (sendhead_ * 2 >= sendq_.size()) {
+        size_t base = sendq_[sendhead_].off;
+        sendbuf_.erase(sendbuf_.begin(), sendbuf_.begin() + base);
+        sendq_.erase(sendq_.begin(), sendq_.begin() + sendhead_);
+        for (auto& d : sendq_) d.off -= base;
+        sendhead_ = 0;
+    }
+    if (!writing_ && started_) {
+        writing_ = true;
+        ev_->enable_write();
+    }
+}
+
+/**
+ * @brief Sends the first `count` queued datagrams one message each, without GSO.
+ *
+ * Used when the kernel rejects a coalesced run. A datagram is counted as a drop
+ * only if this plain send fails with a hard error too.
+ *
+ * @param count Number of datagrams from the head of the queue.
+ * @return false if the socket would block; the rest stays queued.
+ */
+bool udpevent::send_plain(size_t count) {
+    while (count > 0 && sendhead_ < sendq_.size()) {
+        const dgram& d = sendq_[sendhead_];
+        ssize_t n;
+        if (connected_)
+            n = ::send(fd_, &sendbuf_[d.off], d.len, 0);
+        else
+            n = ::sendto(fd_, &sendbuf_[d.off], d.len, 0,
+                         (const sockaddr*)&d.addr, sizeof(sockaddr_in));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                return false;
+            perror("sendto failed");
+            ++stats_.drops;
+        } else {
+            ++stats_.txpkts;
+            stats_.txbytes += d.len;
+        }
+        ++sendhead_;
+        --count;
+    }
+    return true;
+}
+
+/**
+ * @brief Turns this socket into the entry point for connected per-peer sessions.
+ *
+ * For the first datagram from an unknown peer a new `udpevent` is bound to the same
+ * port, `connect`ed to the peer and created on the loop returned by `pick` (or this
+ * event's loop). `ncb` runs on this event's thread with the session and that first
+ * datagram; it should set the session's callbacks, after which the session starts
+ * listening. From then on the kernel demultiplexes the peer's datagrams to the session
+ * socket. Datagrams of known peers that were already queued on this socket, and the
+ * rest of a GRO buffer whose first segment created the session, are passed to the
+ * session's datagram callback on this event's thread. Sessions are owned by the caller.
+ *
+ * @param ncb The callback receiving each new session.
+ * @param pick Chooses the loop of a new session; may be empty.
+ */
+void udpevent::set_session(const NCallback& ncb, const LCallback& pick) {
+    session_cb_ = ncb;
+    pick_ = pick;
+    if (ncb && !sessions_) sessions_ = std::make_shared<sessreg>();
+}
+
+bool udpevent::connected() const { return connected_; }
+
+const sockaddr_in& udpevent::getpeer() const { return peer_; }
+
+/**
+ * @brief Sends a datagram to the peer of a connected session.
+ *
+ * Uses `send` semantics: no destination address is passed to the kernel.
+ *
+ * @param data Pointer to the datagram payload.
+ * @param len The payload length in bytes.
+ */
+void udpevent::send(const char* data, size_t len) {
+    send_to(data, len, peer_);
+}
+
+/**
+ * Looks the peer up in the shared registry and creates its session if there is none.
+ * A new session gets the first segment through `session_cb_`; every other segment,
+ * and every datagram of a peer that already has a session, goes to the session's own
+ * `dgram_cb_` while the registry lock is held, so the session cannot be destroyed by
+ * its loop in the meantime.
+ *
+ * @return `false` if no session could be created, in which case the caller keeps the
+ * datagrams.
+ */
+bool udpevent::divert(const char* data, size_t len, size_t seg,
+                      const sockaddr_in& peer) {
+    uint64_t key = peerkey(peer);
+    std::unique_lock<std::recursive_mutex> lock(sessions_->mutex);
+    size_t off = 0;
+    if (!sessions_->peers.count(key)) {
+        lock.unlock();
+        eventloop* loop = pick_ ? pick_() : loop_;
+        udpevent* session = new udpevent(loop, port_, peer);
+        if (session->fd_ < 0) {
+            delete session;
+            return false;
+        }
+        session->sessions_ = sessions_;
+        lock.lock();
+        sessions_->peers[key] = session;
+        lock.unlock();
+        session_cb_(session, data, std::min(seg, len));
+        session->enable_listen();
+        if (len <= seg) return true;
+        off = seg;
+        lock.lock();
+    }
+    do {
+        // 回调可能析构会话，每段重新查找
+        auto it = sessions_->peers.find(key);
+        if (it == sessions_->peers.end() || !it->second->dgram_cb_) break;
+        udpevent* session = it->second;
+        session->dgram_cb_(data + off, std::min(seg, len - off), peer, session);
+        off += seg;
+    } while (off < len);
+    return true;
+}
+
+/**
+ * @brief Enables or disables UDP generic segmentation offload on send.
+ *
+ * When enabled, `flush_queue` passes runs of queued datagrams that go to the same
+ * destination and have the same length (the last one may be shorter) to the kernel
+ * as one buffer with a `UDP_SEGMENT` size, so a single send covers up to 64
+ * datagrams. Only queued datagrams are coalesced, so it pairs with `set_sendbatch`.
+ *
+ * @param on Whether to use GSO.
+ *
+ * @return `false` if the kernel does not support `UDP_SEGMENT`.
+ */
+bool udpevent::set_gso(bool on) {
+    if (on) {
+        int val = 0;
+        if (setsockopt(fd_, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == -1) {
+            perror("setsockopt UDP_SEGMENT");
+            return false;
+        }
+    }
+    gso_ = on;
+    return true;
+}
+
+/**
+ * @brief Enables or disables UDP generic receive offload.
+ *
+ * With GRO the kernel may deliver several datagrams from one sender as one buffer.
+ * The batched receive path reads the segment size from the `UDP_GRO` control
+ * message and calls the datagram callback once per original datagram. Receive slots
+ * grow to 64KB to hold coalesced buffers. Use together with `setdcb`; the legacy
+ * `recvfrom` path cannot split coalesced buffers.
+ *
+ * @param on Whether to use GRO.
+ *
+ * @return `false` if the kernel does not support `UDP_GRO`.
+ */
+bool udpevent::set_gro(bool on) {
+    int val = on ? 1 : 0;
+    if (setsockopt(fd_, SOL_UDP, UDP_GRO, &val, sizeof(val)) == -1) {
+        perror("setsockopt UDP_GRO");
+        return false;
+    }
+    gro_ = on;
+    if (on) mtu_ = IOBUF;
+    return true;
+}
+
+/**
+ * @brief Steers datagrams of the port's `SO_REUSEPORT` group by receiving CPU.
+ *
+ * Attaches a classic BPF program that returns, for a datagram processed on
+ * `cpus[i]`, the index `i` of the socket in the group (sockets are indexed in the
+ * order they were bound). Other CPUs map to `cpu % cpus.size()`. With one shard
+ * per loop and loop `i` pinned to `cpus[i]`, a flow is handled on the CPU that
+ * received it. The program applies to the whole group, so calling it on any
+ * member is enough. Connected session sockets in the group make the kernel fall
+ * back to its own selection.
+ *
+ * @param cpus The CPU served by each socket of the group, in bind order.
+ *
+ * @return `false` if the program could not be attached.
+ */
+bool udpevent::set_cpusteer(const std::vector<int>& cpus) {
+    if (cpus.empty()) return false;
+    auto insn = [](uint16_t op, uint32_t k, uint8_t jt, uint8_t jf) {
+        sock_filter f = {op, jt, jf, k};
+        return f;
+    };
+    std::vector<sock_filter> code;
+    code.push_back(
+        insn(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU), 0, 0));
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (cpus[i] < 0) continue;
+        code.push_back(insn(BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1));
+        code.push_back(insn(BPF_RET | BPF_K, i, 0, 0));
     }
+    code.push_back(insn(BPF_ALU | BPF_MOD | BPF_K, cpus.size(), 0, 0));
+    code.push_back(insn(BPF_RET | BPF_A, 0, 0, 0));
+    sock_fprog prog;
+    prog.len = code.size();
+    prog.filter = code.data();
+    if (setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                   sizeof(prog)) == -1) {
+        perror("setsockopt SO_ATTACH_REUSEPORT_CBPF");
+        return false;
+    }
+    return true;
+}
+
+void udpevent::handle_send() { flush_queue(); }
+
+void udpevent::handle_flush() {
+    flushq_ = false;
+    if (!writing_) flush_queue();
 }
 
 /**
@@ -234,13 +803,20 @@ void udpevent::send_to(const std::string& data, const sockaddr_in& addr) {
  * errors, it invokes the event callback.
  */
 void udpevent::handle_receive() {
+    if (dgram_cb_) {
+        handle_receive_batch();
+        return;
+    }
     while (true) {
-        char buf[BUFSIZE];
+        char buf[IOBUF];
         struct sockaddr_in cli_addr;
         socklen_t cli_len = sizeof(cli_addr);
         ssize_t n = recvfrom(fd_, buf, sizeof(buf), 0,
                              (struct sockaddr*)&cli_addr, &cli_len);
         if (n > 0) {
+            ++stats_.rxpkts;
+            stats_.rxbytes += n;
+            if (session_cb_ && divert(buf, n, n, cli_addr)) continue;
             inbuff_.append(buf, n);
             if (receive_cb_) {
                 receive_cb_(cli_addr, this);
@@ -261,6 +837,56 @@ void udpevent::handle_receive() {
     }
 }
 
+/**
+ * @brief Receives datagrams in batches with `recvmmsg`.
+ *
+ * Fills up to `batch_` slots per system call and hands each datagram to `dgram_cb_`.
+ * Reading stops once a call returns fewer datagrams than requested, which means the
+ * socket queue was drained.
+ */
+void udpevent::handle_receive_batch() {
+    slots.reserve(mtu_, batch_);
+    while (dgram_cb_) {
+        slots.prepare(mtu_, batch_, gro_);
+        int n = recvmmsg(fd_, slots.msgs.data(), batch_, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recvmmsg failed");
+                if (event_cb_) event_cb_();
+            }
+            break;
+        }
+        for (int i = 0; i < n && dgram_cb_; ++i) {
+            msghdr& hdr = slots.msgs[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC) ++stats_.truncated;
+            const char* data = &slots.data[i * slots.mtu];
+            size_t len = slots.msgs[i].msg_len;
+            size_t seg = len;
+            stats_.rxbytes += len;
+            if (gro_) {
+                for (cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm;
+                     cm = CMSG_NXTHDR(&hdr, cm)) {
+                    if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                        int gs;
+                        memcpy(&gs, CMSG_DATA(cm), sizeof(gs));
+                        if (gs > 0) seg = gs;
+                    }
+                }
+            }
+            // GRO合并的缓冲区按段长拆回原始数据报
+            stats_.rxpkts += len > 0 ? (len + seg - 1) / seg : 1;
+            if (session_cb_ && divert(data, len, seg, slots.addrs[i])) continue;
+            for (size_t off = 0; off < len && dgram_cb_; off += seg) {
+                dgram_cb_(data + off, std::min(seg, len - off), slots.addrs[i],
+                          this);
+            }
+            if (len == 0) dgram_cb_(data, 0, slots.addrs[i], this);
+        }
+        if (n < batch_) break;
+    }
+}
+
 void udpevent::enable_read() { ev_->enable_read(); }
 
 void udpevent::enable_ET() { ev_->enable_ET(); }
@@ -271,6 +897,7 @@ void udpevent::disable_ET() { ev_->disable_read(); }
 
 void udpevent::disable_cb() {
     receive_cb_ = nullptr;
+    dgram_cb_ = nullptr;
     event_cb_ = nullptr;
 }
 
@@ -0,0 +1,256 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "watchdog.h"
+#include "eventloop.h"
+#include "signalevent.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace moon;
+
+namespace {
+    // 同一时刻只抓取一个线程的调用栈，由信号处理函数写入
+    enum { CAP_IDLE, CAP_REQUESTED, CAP_RUNNING, CAP_DONE };
+    std::mutex capmutex;
+    std::atomic<int> capstate{CAP_IDLE};
+    void* capframes[WATCHDOG_MAX_FRAMES];
+    int capnframes = 0;
+
+    void on_capture(int) {
+        int saved = errno;
+        int expect = CAP_REQUESTED;
+        if (capstate.compare_exchange_strong(expect, CAP_RUNNING)) {
+            capnframes = backtrace(capframes, WATCHDOG_MAX_FRAMES);
+            capstate.store(CAP_DONE);
+        }
+        errno = saved;
+    }
+
+    void install_handler() {
+        static std::once_flag once;
+        std::call_once(once, [] {
+            // backtrace首次调用会加载libgcc，不能发生在信号处理函数中
+            void* frame;
+            backtrace(&frame, 1);
+            struct sigaction sa;
+            sa.sa_handler = on_capture;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESTART;
+            if (sigaction(WATCHDOG_SIGNAL, &sa, nullptr) == -1) {
+                perror("watchdog sigaction");
+            }
+        });
+    }
+}  // namespace
+
+/**
+ * @brief Constructs a watchdog; nothing is observed until `watch` and `start`.
+ *
+ * @param threshold_ms Callbacks running longer than this are reported.
+ * @param cb Sink for stall records; defaults to printing on stderr.
+ */
+watchdog::watchdog(int threshold_ms, const WCallback& cb)
+    : threshold_us_(std::max(threshold_ms, 1) * 1000),
+      interval_ms_(std::max(threshold_ms / 4, 1)),
+      stallcb_(cb) {}
+
+/**
+ * @brief Destructs the watchdog, stopping its thread and detaching all loops.
+ */
+watchdog::~watchdog() {
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& w : loops_) w.loop->setwatchdog(nullptr);
+    loops_.clear();
+}
+
+/**
+ * @brief Starts observing a loop.
+ *
+ * The loop publishes heartbeats from its next iteration on. A loop can be
+ * observed by only one watchdog at a time.
+ *
+ * @param loop Pointer to the `eventloop` to observe.
+ */
+void watchdog::watch(eventloop* loop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& w : loops_) {
+        if (w.loop == loop) return;
+    }
+    loops_.push_back({loop, 0});
+    loop->setwatchdog(this);
+}
+
+/**
+ * @brief Stops observing a loop. Called by the loop's destructor.
+ *
+ * @param loop Pointer to the `eventloop`.
+ */
+void watchdog::unwatch(eventloop* loop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = loops_.begin(); it != loops_.end(); ++it) {
+        if (it->loop == loop) {
+            loops_.erase(it);
+            loop->setwatchdog(nullptr);
+            return;
+        }
+    }
+}
+
+void watchdog::setcb(const WCallback& cb) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stallcb_ = cb;
+}
+
+/**
+ * @brief Starts the watchdog thread and installs the `WATCHDOG_SIGNAL` handler.
+ *
+ * The handler is process-wide; loop threads must not block `WATCHDOG_SIGNAL`
+ * or their stacks cannot be captured.
+ */
+void watchdog::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    install_handler();
+    running_ = true;
+    thread_ = std::thread(&watchdog::run, this);
+}
+
+void watchdog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+size_t watchdog::getstalls() const { return stalls_.load(); }
+
+/**
+ * @brief Watchdog thread: polls the heartbeats every quarter of the threshold.
+ */
+void watchdog::run() {
+    signalevent::block_subscribed();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        cond_.wait_for(lock, std::chrono::milliseconds(interval_ms_));
+        if (!running_) break;
+        for (auto& w : loops_) check(w.loop, w.reported);
+    }
+}
+
+/**
+ * @brief Reports the loop's current callback if it exceeds the threshold.
+ *
+ * Each stalled callback is reported once. Called with `mutex_` held, so a loop
+ * cannot be destroyed while its stack is being captured.
+ *
+ * @param loop Pointer to the observed `eventloop`.
+ * @param reported Sequence number of the last reported callback.
+ */
+void watchdog::check(eventloop* loop, uint64_t& reported) {
+    stallinfo info;
+    info.loop = loop;
+    info.elapsed_us = loop->getheartbeat(info.seq, info.fd, info.ev);
+    if (info.elapsed_us < (uint64_t)threshold_us_ || info.seq == reported)
+        return;
+    capture(loop, info.backtrace);
+    // 抓取期间回调已返回，调用栈不再对应这次卡顿
+    uint64_t seq;
+    int fd;
+    event* ev;
+    if (loop->getheartbeat(seq, fd, ev) == 0 || seq != info.seq)
+        info.backtrace.clear();
+    reported = info.seq;
+    ++stalls_;
+    if (stallcb_)
+        stallcb_(info);
+    else
+        print(info);
+}
+
+/**
+ * @brief Captures the call stack of the loop's thread.
+ *
+ * Sends `WATCHDOG_SIGNAL` to the thread, whose handler records the frames with
+ * backtrace(3); symbols are resolved here, outside the handler. Gives up after
+ * 100ms, e.g. when the thread blocks the signal, and does nothing while the loop is
+ * not running. Like any signal, it may cut a
+ * blocking call in the stalled callback short with EINTR.
+ *
+ * @param loop Pointer to the stalled `eventloop`.
+ * @param bt Receives one symbolized line per frame, innermost first.
+ */
+void watchdog::capture(eventloop* loop, std::vector<std::string>& bt) {
+    pthread_t tid = loop->getthread();
+    if (tid == 0) return;  // loop尚未运行或已退出
+    std::lock_guard<std::mutex> lock(capmutex);
+    capstate.store(CAP_REQUESTED);
+    if (pthread_kill(tid, WATCHDOG_SIGNAL) != 0) {
+        capstate.store(CAP_IDLE);
+        return;
+    }
+    for (int i = 0; i < 100 && capstate.load() != CAP_DONE; ++i) {
+        usleep(1000);
+    }
+    int expect = CAP_REQUESTED;
+    if (capstate.compare_exchange_strong(expect, CAP_IDLE)) return;  // 超时
+    while (capstate.load() != CAP_DONE) usleep(100);
+    // 跳过信号处理函数自身的栈帧
+    char** syms = backtrace_symbols(capframes, capnframes);
+    for (int i = 1; i < capnframes; ++i) {
+        bt.emplace_back(syms ? syms[i] : "?");
+    }
+    free(syms);
+    capstate.store(CAP_IDLE);
+}
+
+void watchdog::print(const stallinfo& info) {
+    fprintf(stderr,
+            "watchdog: loop %p stalled %llu ms in callback of fd %d (seq "
+            "%llu)\n",
+            (void*)info.loop, (unsigned long long)info.elapsed_us / 1000,
+            info.fd, (unsigned long long)info.seq);
+    for (auto& frame : info.backtrace) {
+        fprintf(stderr, "    %s\n", frame.c_str());
+    }
+}
@@ -0,0 +1,362 @@
+/* BSD 3-Clause License
+
+Copyright (c) 2024, MoonforDream
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Author: MoonforDream
+
+*/
+
+#include "wsthreadpool.h"
+#include "signalevent.h"
+
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace moon;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be a plain 32-bit integer");
+
+namespace {
+    // 当前线程所属的池与工作线程下标，用于判断任务是否在池内提交
+    thread_local wsthreadpool* tls_pool = nullptr;
+    thread_local size_t tls_idx = 0;
+
+    int futex_wait(std::atomic<uint32_t>* addr, uint32_t val) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                       FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+    }
+
+    int futex_wake(std::atomic<uint32_t>* addr, int n) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                       FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+    }
+}  // namespace
+
+wsdeque::array::array(int64_t n)
+    : mask(n - 1), slots(new std::atomic<task*>[n]) {}
+
+wsdeque::array::~array() { delete[] slots; }
+
+wsdeque::task* wsdeque::array::get(int64_t i) const {
+    return slots[i & mask].load(std::memory_order_relaxed);
+}
+
+void wsdeque::array::put(int64_t i, task* t) {
+    slots[i & mask].store(t, std::memory_order_relaxed);
+}
+
+wsdeque::wsdeque()
+    : top_(0), bottom_(0), arr_(new array(WSDEQUE_INIT_SIZE)) {}
+
+/**
+ * @brief Frees the current array and every array retired by growth. Tasks
+ * still queued are not owned by the deque and are left to the pool.
+ */
+wsdeque::~wsdeque() {
+    delete arr_.load(std::memory_order_relaxed);
+    for (array* a : old_) delete a;
+}
+
+/**
+ * @brief Doubles the circular array, copying the live range [t, b).
+ *
+ * The old array is kept until the deque is destroyed because a thief may
+ * have loaded it just before the swap and still be reading a slot.
+ *
+ * @param a The current array.
+ * @param b The current bottom index.
+ * @param t The current top index.
+ * @return array* The new array.
+ */
+wsdeque::array* wsdeque::grow(array* a, int64_t b, int64_t t) {
+    array* na = new array((a->mask + 1) * 2);
+    for (int64_t i = t; i < b; ++i) na->put(i, a->get(i));
+    old_.push_back(a);
+    arr_.store(na, std::memory_order_release);
+    return na;
+}
+
+/**
+ * @brief Pushes a task at the bottom. Owner thread only.
+ *
+ * @param t The task to push.
+ */
+void wsdeque::push(task* t) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t tp = top_.load(std::memory_order_acquire);
+    array* a = arr_.load(std::memory_order_relaxed);
+    if (b - tp > a->mask) a = grow(a, b, tp);
+    a->put(b, t);
+    bottom_.store(b + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Pops the most recently pushed task. Owner thread only.
+ *
+ * When a single task is left, the owner races thieves for it with a CAS on
+ * top, exactly like a steal.
+ *
+ * @return task* The task, or nullptr if the deque is empty or the last task
+ * was stolen.
+ */
+wsdeque::task* wsdeque::pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    array* a = arr_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    task* x = a->get(b);
+    if (t == b) {
+        if (!top_.compare_exchange_strong(t, t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+            x = nullptr;
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+}
+
+/**
+ * @brief Takes the oldest task from the top. Safe from any thread.
+ *
+ * @return task* The task, or nullptr if the deque is empty or another thread
+ * won the race for the same slot.
+ */
+wsdeque::task* wsdeque::steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    array* a = arr_.load(std::memory_order_acquire);
+    task* x = a->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+        return nullptr;
+    return x;
+}
+
+bool wsdeque::empty() const { return size() == 0; }
+
+size_t wsdeque::size() const {
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    int64_t t = top_.load(std::memory_order_acquire);
+    return b > t ? (size_t)(b - t) : 0;
+}
+
+/**
+ * @brief Constructs the pool and starts its workers.
+ *
+ * @param tnum Number of worker threads; -1 (or 0) uses the number of CPU
+ * cores.
+ */
+wsthreadpool::wsthreadpool(int tnum)
+    : injectsize_(0),
+      epoch_(0),
+      idle_(0),
+      shutdown_(false),
+      steals_(0),
+      parks_(0) {
+    if (tnum <= 0) tnum = std::thread::hardware_concurrency();
+    if (tnum <= 0) tnum = 1;
+    // 先建好全部工作线程结构，窃取时会遍历workers_
+    for (int i = 0; i < tnum; ++i) {
+        worker* w = new worker;
+        w->seed = 2654435761u * (i + 1);
+        workers_.push_back(w);
+    }
+    for (int i = 0; i < tnum; ++i)
+        workers_[i]->t = std::thread(&wsthreadpool::run, this, i);
+}
+
+wsthreadpool::~wsthreadpool() {
+    t_shutdown();
+    for (worker* w : workers_) delete w;
+    for (task* t : inject_) delete t;
+}
+
+/**
+ * @brief Stops accepting external tasks, runs everything already queued
+ * (including tasks those tasks spawn) and joins the workers. Must not be
+ * called from inside a task of this pool.
+ */
+void wsthreadpool::t_shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(injectmx_);
+        shutdown_.store(true, std::memory_order_seq_cst);
+    }
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(&epoch_, INT_MAX);
+    for (worker* w : workers_)
+        if (w->t.joinable()) w->t.join();
+}
+
+/**
+ * @brief Queues a heap-allocated task and wakes a parked worker if any.
+ *
+ * The fence pairs with the one in park(): either the submitter sees the
+ * parking worker's idle count and bumps the futex word, or the worker's
+ * re-check sees the new task.
+ *
+ * @param t The task; ownership passes to the pool on success.
+ * @return bool false if an external submission arrives after shutdown.
+ */
+bool wsthreadpool::submit(task* t) {
+    if (tls_pool == this) {
+        workers_[tls_idx]->dq.push(t);
+    } else {
+        std::lock_guard<std::mutex> lock(injectmx_);
+        if (shutdown_.load(std::memory_order_relaxed)) return false;
+        inject_.push_back(t);
+        injectsize_.fetch_add(1, std::memory_order_release);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_.load(std::memory_order_relaxed) > 0) wake(1);
+    return true;
+}
+
+/**
+ * @brief Worker main loop: run local, injected or stolen tasks; park when
+ * none can be found; exit once shut down and every queue is empty.
+ *
+ * @param idx Index of this worker in workers_.
+ */
+void wsthreadpool::run(size_t idx) {
+    signalevent::block_subscribed();
+    tls_pool = this;
+    tls_idx = idx;
+    while (true) {
+        task* t = find_task(idx);
+        if (t) {
+            (*t)();
+            delete t;
+            continue;
+        }
+        if (shutdown_.load(std::memory_order_acquire) && !has_work()) break;
+        park();
+    }
+    tls_pool = nullptr;
+}
+
+/**
+ * @brief Looks for the next task: own deque (LIFO) first, then the injection
+ * queue, then one steal attempt (FIFO) from each other worker, starting at a
+ * random victim so thieves spread out.
+ *
+ * @param idx Index of the calling worker.
+ * @return task* The task, or nullptr if none was found.
+ */
+wsthreadpool::task* wsthreadpool::find_task(size_t idx) {
+    worker* self = workers_[idx];
+    task* t = self->dq.pop();
+    if (t) return t;
+    t = take_inject();
+    if (t) return t;
+    size_t n = workers_.size();
+    if (n < 2) return nullptr;
+    // xorshift32
+    uint32_t s = self->seed;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    self->seed = s;
+    size_t start = s % n;
+    for (size_t i = 0; i < n; ++i) {
+        size_t v = (start + i) % n;
+        if (v == idx) continue;
+        t = workers_[v]->dq.steal();
+        if (t) {
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+wsthreadpool::task* wsthreadpool::take_inject() {
+    if (injectsize_.load(std::memory_order_acquire) == 0) return nullptr;
+    std::lock_guard<std::mutex> lock(injectmx_);
+    if (inject_.empty()) return nullptr;
+    task* t = inject_.front();
+    inject_.pop_front();
+    injectsize_.fetch_sub(1, std::memory_order_relaxed);
+    return t;
+}
+
+bool wsthreadpool::has_work() const {
+    if (injectsize_.load(std::memory_order_acquire) > 0) return true;
+    for (const worker* w : workers_)
+        if (!w->dq.empty()) return true;
+    return false;
+}
+
+/**
+ * @brief Sleeps on the futex word until a submitter or shutdown bumps it.
+ *
+ * The word is read before announcing idleness, so a wake that lands between
+ * the re-check and FUTEX_WAIT changes the value and the wait returns at once.
+ */
+void wsthreadpool::park() {
+    uint32_t e = epoch_.load(std::memory_order_acquire);
+    idle_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_work() || shutdown_.load(std::memory_order_seq_cst)) {
+        idle_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    parks_.fetch_add(1, std::memory_order_relaxed);
+    futex_wait(&epoch_, e);
+    idle_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void wsthreadpool::wake(int n) {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(&epoch_, n);
+}
+
+int wsthreadpool::getthreads() const { return (int)workers_.size(); }
+
+size_t wsthreadpool::getpending() const {
+    size_t n = injectsize_.load(std::memory_order_relaxed);
+    for (const worker* w : workers_) n += w->dq.size();
+    return n;
+}
+
+uint64_t wsthreadpool::getsteals() const {
+    return steals_.load(std::memory_order_relaxed);
+}
+
+uint64_t wsthreadpool::getparks() const {
+    return parks_.load(std::memory_order_relaxed);
+}